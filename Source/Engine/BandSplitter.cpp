@@ -0,0 +1,309 @@
+/*
+  ==============================================================================
+
+    BandSplitter.cpp
+    Created: 14 Jun 2023 8:26:03pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "BandSplitter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // modified Bessel function of the first kind, order 0, for the Kaiser window
+    double besselI0 (double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 64 && term > 1.0e-12 * sum; ++k) {
+            term *= (0.5 * x / k) * (0.5 * x / k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    // input into a history of length values written twice, returns the last length inputs, oldest first
+    inline const float* push (float* history, int length, int& position, float input) noexcept
+    {
+        history[position] = input;
+        history[position + length] = input;
+        const float* window = history + position + 1;
+        position = position + 1 == length ? 0 : position + 1;
+        return window;
+    }
+
+    // the delayed sample from a ring in place of data[index * stride], for count samples
+    inline int delay (float* ring, int length, int position, const float* data, float* delayed, int count, int stride) noexcept
+    {
+        for (int index = 0; index < count; ++index) {
+            delayed[index] = ring[position];
+            ring[position] = data[(size_t)index * stride];
+            if (++position >= length)
+                position = 0;
+        }
+        return position;
+    }
+}
+
+//==============================================================================
+int BandSplitter::getNumStages (double sampleRate, double splitFrequency) noexcept
+{
+    int numStages = 0;
+    while (numStages < maxStages && maxPassband * sampleRate / (2 << numStages) >= splitFrequency)
+        ++numStages;
+    return splitFrequency > 0.0 ? numStages : 0;
+}
+
+void BandSplitter::prepare (double sampleRate, double splitFrequency, int newNumStages, int numChannels, int maxBlockSize, int lowLatency)
+{
+    numStages = std::min (maxStages, std::max (0, newNumStages));
+    stages.assign ((size_t)numStages, Stage());
+    lowBuffers.clear();
+    lowDelay.clear();
+    lowDry.clear();
+    lowChannels.clear();
+    inputDelay.clear();
+    delayedInput.clear();
+    queue.clear();
+    scratch.clear();
+    latency = 0;
+    if (numStages == 0)
+        return;
+
+    // Kaiser window design. Stage s runs at sampleRate / 2^s and has to keep the band below splitFrequency, the
+    // rest of its band may alias, as long as it only lands above splitFrequency. So the transition reaches from
+    // splitFrequency to its mirror image around a quarter of the rate, and the later stages need longer filters
+    const int factor = getFactor();
+    const double beta = 0.1102 * (attenuationDb - 8.7);
+    latency = factor - 1;
+    for (int index = 0; index < numStages; ++index) {
+        Stage& stage = stages[(size_t)index];
+        const double rate = sampleRate / (1 << index);
+        const double transition = std::max (0.05, 0.5 - 2.0 * splitFrequency / rate);
+        const int length = (int)std::ceil ((attenuationDb - 7.95) / (14.36 * transition)) + 1;
+        stage.halfLength = std::max (1, (length + 4) / 4);
+
+        // the ideal half band at odd offsets k is sin (pi k / 2) / (pi k), normalised to unit gain at DC
+        stage.taps.resize ((size_t)stage.halfLength);
+        double sum = 0.0;
+        for (int tap = 0; tap < stage.halfLength; ++tap) {
+            const int offset = 2 * tap + 1;
+            const double position = (double)offset / (2 * stage.halfLength);
+            const double window = besselI0 (beta * std::sqrt (1.0 - position * position)) / besselI0 (beta);
+            const double value = (tap % 2 == 0 ? 1.0 : -1.0) / (M_PI * offset) * window;
+            stage.taps[(size_t)tap] = (float)value;
+            sum += value;
+        }
+        for (float& tap : stage.taps)
+            tap = (float)(tap * 0.25 / sum);
+
+        stage.decimatorHistory.assign ((size_t)numChannels, std::vector<float> ((size_t)(2 * (4 * stage.halfLength - 1)), 0.0f));
+        stage.interpolatorHistory.assign ((size_t)numChannels, std::vector<float> ((size_t)(4 * stage.halfLength), 0.0f));
+        // both filters are centred 2 halfLength - 1 samples back at this rate, the decimator's from
+        // its last input, which an output follows, the interpolator's from its first output
+        latency += (4 * stage.halfLength - 3) << index;
+    }
+
+    const int maxLowSamples = maxBlockSize / factor + 1;
+    lowBuffers.assign ((size_t)numChannels, std::vector<float> ((size_t)maxLowSamples, 0.0f));
+    lowDry.assign ((size_t)numChannels, std::vector<float> ((size_t)maxLowSamples, 0.0f));
+    lowDelay.assign ((size_t)numChannels, std::vector<float> ((size_t)std::max (0, lowLatency), 0.0f));
+    lowChannels.assign ((size_t)numChannels, nullptr);
+    for (size_t channel = 0; channel < lowBuffers.size(); ++channel)
+        lowChannels[channel] = lowBuffers[channel].data();
+
+    inputDelay.assign ((size_t)numChannels, std::vector<float> ((size_t)(latency + factor * std::max (0, lowLatency)), 0.0f));
+    delayedInput.assign ((size_t)numChannels, std::vector<float> ((size_t)std::max (1, maxBlockSize), 0.0f));
+    queue.assign ((size_t)numChannels, std::vector<float> ((size_t)factor, 0.0f));
+    scratch.assign ((size_t)(2 * factor), 0.0f);
+    reset();
+}
+
+void BandSplitter::reset() noexcept
+{
+    for (Stage& stage : stages) {
+        for (auto& history : stage.decimatorHistory)
+            std::fill (history.begin(), history.end(), 0.0f);
+        for (auto& history : stage.interpolatorHistory)
+            std::fill (history.begin(), history.end(), 0.0f);
+        stage.decimatorPosition = 0;
+        stage.interpolatorPosition = 0;
+        stage.odd = false;
+    }
+    for (auto& ring : lowDelay)
+        std::fill (ring.begin(), ring.end(), 0.0f);
+    for (auto& ring : inputDelay)
+        std::fill (ring.begin(), ring.end(), 0.0f);
+    for (auto& samples : queue)
+        std::fill (samples.begin(), samples.end(), 0.0f);
+    lowDelayPosition = 0;
+    inputDelayPosition = 0;
+    numLowSamples = 0;
+    queueCount = numStages > 0 ? getFactor() - 1 : 0;
+}
+
+int BandSplitter::split (const float* const* channels, int numBlockChannels, int numSamples, int stride) noexcept
+{
+    numLowSamples = 0;
+    if (numStages == 0 || numSamples <= 0)
+        return 0;
+
+    numBlockChannels = std::min (numBlockChannels, (int)lowBuffers.size());
+    numSamples = std::min (numSamples, (int)delayedInput.front().size());
+    const float gain = (float)getFactor();
+    int positions[maxStages] {};
+    bool odd[maxStages] {};
+    for (int channel = 0; channel < numBlockChannels; ++channel) {
+        for (int index = 0; index < numStages; ++index) {
+            positions[index] = stages[(size_t)index].decimatorPosition;
+            odd[index] = stages[(size_t)index].odd;
+        }
+
+        const float* input = channels[channel];
+        float* low = lowBuffers[(size_t)channel].data();
+        int count = 0;
+        for (int sample = 0; sample < numSamples; ++sample) {
+            float value = input[(size_t)sample * stride];
+            int index = 0;
+            for (; index < numStages; ++index) {
+                Stage& stage = stages[(size_t)index];
+                const int halfLength = stage.halfLength;
+                const float* window = push (stage.decimatorHistory[(size_t)channel].data(), 4 * halfLength - 1, positions[index], value);
+                odd[index] = ! odd[index];
+                if (odd[index])
+                    break;
+
+                // y = 0.5 x[n - c] + sum of taps[i] * (x[n - c + 2i + 1] + x[n - c - 2i - 1]), c = 2 halfLength - 1
+                float sum = 0.5f * window[2 * halfLength - 1];
+                for (int tap = 0; tap < halfLength; ++tap)
+                    sum += stage.taps[(size_t)tap] * (window[2 * halfLength - 2 - 2 * tap] + window[2 * halfLength + 2 * tap]);
+                value = sum;
+            }
+            if (index == numStages)
+                low[count++] = value * gain;
+        }
+        numLowSamples = count;
+
+        const int length = (int)lowDelay[(size_t)channel].size();
+        if (length > 0)
+            delay (lowDelay[(size_t)channel].data(), length, lowDelayPosition, low, lowDry[(size_t)channel].data(), count, 1);
+        else
+            std::copy (low, low + count, lowDry[(size_t)channel].begin());
+        delay (inputDelay[(size_t)channel].data(), (int)inputDelay[(size_t)channel].size(), inputDelayPosition,
+               input, delayedInput[(size_t)channel].data(), numSamples, stride);
+    }
+
+    for (int index = 0; index < numStages; ++index) {
+        stages[(size_t)index].decimatorPosition = positions[index];
+        stages[(size_t)index].odd = odd[index];
+    }
+    if (! lowDelay.front().empty())
+        lowDelayPosition = (int)((lowDelayPosition + (int64_t)numLowSamples) % (int64_t)lowDelay.front().size());
+    inputDelayPosition = (int)((inputDelayPosition + (int64_t)numSamples) % (int64_t)inputDelay.front().size());
+    return numLowSamples;
+}
+
+void BandSplitter::merge (float* const* channels, int numBlockChannels, int numSamples, int stride) noexcept
+{
+    if (numStages == 0 || numSamples <= 0)
+        return;
+
+    numBlockChannels = std::min (numBlockChannels, (int)lowBuffers.size());
+    numSamples = std::min (numSamples, (int)delayedInput.front().size());
+    const int factor = getFactor();
+    const float gain = 1.0f / (float)factor;
+    int positions[maxStages] {};
+    int count = queueCount;
+    for (int channel = 0; channel < numBlockChannels; ++channel) {
+        for (int index = 0; index < numStages; ++index)
+            positions[index] = stages[(size_t)index].interpolatorPosition;
+
+        const float* low = lowBuffers[(size_t)channel].data();
+        const float* dry = lowDry[(size_t)channel].data();
+        const float* delayed = delayedInput[(size_t)channel].data();
+        float* pending = queue[(size_t)channel].data();
+        float* output = channels[channel];
+        int lowIndex = 0;
+        count = queueCount;
+        for (int sample = 0; sample < numSamples; ++sample) {
+            if (count == 0 && lowIndex < numLowSamples) {
+                // one decimated sample up through every stage, each output of one the input of the next
+                float* values = scratch.data();
+                values[0] = (low[lowIndex] - dry[lowIndex]) * gain;
+                ++lowIndex;
+                int numValues = 1;
+                for (int index = numStages - 1; index >= 0; --index) {
+                    Stage& stage = stages[(size_t)index];
+                    const int halfLength = stage.halfLength;
+                    float* next = index == 0 ? pending : (values == scratch.data() ? scratch.data() + factor : scratch.data());
+                    for (int value = 0; value < numValues; ++value) {
+                        const float* window = push (stage.interpolatorHistory[(size_t)channel].data(), 2 * halfLength,
+                                                    positions[index], values[value]);
+                        // zeros in between, through the same filter at twice the gain: the odd outputs are the
+                        // centre tap alone, the even ones every other tap
+                        float sum = 0.0f;
+                        for (int tap = 0; tap < halfLength; ++tap)
+                            sum += stage.taps[(size_t)tap] * (window[halfLength + tap] + window[halfLength - 1 - tap]);
+                        next[2 * value] = 2.0f * sum;
+                        next[2 * value + 1] = window[halfLength];
+                    }
+                    values = next;
+                    numValues *= 2;
+                }
+                count = factor;
+            }
+            output[(size_t)sample * stride] = delayed[sample] + (count > 0 ? pending[factor - count--] : 0.0f);
+        }
+    }
+
+    for (int index = 0; index < numStages; ++index)
+        stages[(size_t)index].interpolatorPosition = positions[index];
+    queueCount = count;
+}
+
+void BandSplitter::saveState (StateWriter& writer) const
+{
+    for (const Stage& stage : stages) {
+        for (const auto& history : stage.decimatorHistory)
+            writer.write (history);
+        for (const auto& history : stage.interpolatorHistory)
+            writer.write (history);
+        writer.write (stage.decimatorPosition);
+        writer.write (stage.interpolatorPosition);
+        writer.write (stage.odd);
+    }
+    for (const auto& ring : lowDelay)
+        writer.write (ring);
+    writer.write (lowDelayPosition);
+    for (const auto& ring : inputDelay)
+        writer.write (ring);
+    writer.write (inputDelayPosition);
+    for (const auto& samples : queue)
+        writer.write (samples);
+    writer.write (queueCount);
+}
+
+void BandSplitter::loadState (StateReader& reader) noexcept
+{
+    for (Stage& stage : stages) {
+        for (auto& history : stage.decimatorHistory)
+            reader.read (history);
+        for (auto& history : stage.interpolatorHistory)
+            reader.read (history);
+        reader.read (stage.decimatorPosition);
+        reader.read (stage.interpolatorPosition);
+        reader.read (stage.odd);
+    }
+    for (auto& ring : lowDelay)
+        reader.read (ring);
+    reader.read (lowDelayPosition);
+    for (auto& ring : inputDelay)
+        reader.read (ring);
+    reader.read (inputDelayPosition);
+    for (auto& samples : queue)
+        reader.read (samples);
+    reader.read (queueCount);
+}
@@ -0,0 +1,100 @@
+/*
+  ==============================================================================
+
+    BandSplitter.h
+    Created: 14 Jun 2023 8:26:03pm
+    Author:  Onez
+
+    Multirate band split for StocSynthEngine::setBandSplit (). The input
+    goes down a cascade of polyphase half-band decimators, each halving
+    the rate, until only the band below the split frequency is left, and
+    the STFT runs on that. The processed low band comes back up through
+    the mirrored cascade of interpolators. Instead of a separate high
+    pass, merge () adds the difference between the processed and the
+    unprocessed low band to the delayed input: whatever the STFT leaves
+    alone comes out as the input, only delayed, and everything above the
+    split passes dry. Half-band filters have every other tap at zero, so
+    a stage costs a quarter of its length per input sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <vector>
+#include "StateBlob.h"
+
+class BandSplitter
+{
+public:
+    // up to a factor of 64
+    static constexpr int maxStages = 6;
+    // The band below splitFrequency has to stay under 0.8 of the decimated Nyquist, as each
+    // stage's transition band reaches from there to its mirror image above the new Nyquist
+    static constexpr double maxPassband = 0.4;
+    // stopband attenuation of every stage
+    static constexpr double attenuationDb = 90.0;
+
+    // How many halvings keep splitFrequency within the passband at this rate (0 = none)
+    static int getNumStages (double sampleRate, double splitFrequency) noexcept;
+
+    // numStages halvings with a passband up to splitFrequency, for numChannels blocks of up to maxBlockSize.
+    // The unprocessed low band is delayed by lowLatency decimated samples, the STFT's latency.
+    // numStages 0 turns it off. Allocates, and clears everything
+    void prepare (double sampleRate, double splitFrequency, int numStages, int numChannels, int maxBlockSize, int lowLatency);
+    void reset() noexcept;
+
+    bool isActive() const noexcept          { return numStages > 0; }
+    int getFactor() const noexcept          { return 1 << numStages; }
+    // delay of the filters, at the full rate. The STFT's latency comes on top, getFactor () times its own
+    int getLatencySamples() const noexcept  { return latency; }
+
+    // numSamples (at most maxBlockSize) of each channel decimated into getLowChannels (), returns how
+    // many came out: numSamples / getFactor (), give or take one. Only reads channels. The low band is
+    // getFactor () times louder, so an FFT that many times shorter sees the magnitudes the full rate FFT
+    // would: the STFT's envelope works on them in dB, and the band split should not change the sound
+    int split (const float* const* channels, int numBlockChannels, int numSamples, int stride) noexcept;
+    float* const* getLowChannels() noexcept { return lowChannels.data(); }
+    // After the low band from split () has been processed in place: back up to the full rate and onto
+    // the delayed input, into channels. Same channels and numSamples as the split () before it
+    void merge (float* const* channels, int numBlockChannels, int numSamples, int stride) noexcept;
+
+    // histories, delays and positions, into a splitter prepared the same way
+    void saveState (StateWriter& writer) const;
+    void loadState (StateReader& reader) noexcept;
+
+private:
+    struct Stage
+    {
+        // taps at odd offsets 1, 3, 5 .. from the centre, which is 0.5 and the only even one
+        std::vector<float> taps;
+        int halfLength = 0;
+        // per channel, decimator: the last 4 * halfLength - 1 inputs, interpolator: the last 2 * halfLength,
+        // both written twice so the newest ones are always in one piece. All channels move together
+        std::vector<std::vector<float>> decimatorHistory, interpolatorHistory;
+        int decimatorPosition = 0;
+        int interpolatorPosition = 0;
+        // whether the next input has an odd index, the decimator gives an output after each of those
+        bool odd = false;
+    };
+
+    int numStages = 0;
+    int latency = 0;
+    int numLowSamples = 0;
+    std::vector<Stage> stages;
+
+    // the low band before processing, lowLatency decimated samples ago
+    std::vector<std::vector<float>> lowBuffers, lowDelay, lowDry;
+    std::vector<float*> lowChannels;
+    int lowDelayPosition = 0;
+
+    // the input, getLatencySamples () plus getFactor () * lowLatency samples ago
+    std::vector<std::vector<float>> inputDelay, delayedInput;
+    int inputDelayPosition = 0;
+
+    // interpolated samples waiting for their block: one decimated sample gives getFactor () of them,
+    // so up to getFactor () - 1 are left over from one block to the next. Starts with that many zeros.
+    // The last queueCount of each are still to come
+    std::vector<std::vector<float>> queue;
+    int queueCount = 0;
+    std::vector<float> scratch;
+};
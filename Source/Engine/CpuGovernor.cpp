@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    CpuGovernor.cpp
+    Created: 21 May 2023 4:12:08pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "CpuGovernor.h"
+#include <algorithm>
+
+void CpuGovernor::prepare (double newSampleRate, int newNumTiers) noexcept
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    numTiers = std::max (1, newNumTiers);
+    reset();
+}
+
+void CpuGovernor::reset() noexcept
+{
+    tier = 0;
+    load = 0.0;
+    sinceChange = 0.0;
+    belowFor = 0.0;
+}
+
+void CpuGovernor::setThresholds (float newStepDownLoad, float newStepUpLoad) noexcept
+{
+    stepDownLoad = newStepDownLoad;
+    stepUpLoad = std::min (newStepUpLoad, newStepDownLoad);
+}
+
+int CpuGovernor::update (double elapsedSeconds, int numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return tier;
+
+    const double budget = numSamples / sampleRate;
+    // one pole, so the average forgets at the same rate whatever the block size
+    const double weight = std::min (1.0, budget / averagingSeconds);
+    load += (elapsedSeconds / budget - load) * weight;
+    sinceChange += budget;
+    belowFor = load < stepUpLoad ? belowFor + budget : 0.0;
+
+    if (sinceChange < holdSeconds)
+        return tier;
+
+    int next = tier;
+    if (load > stepDownLoad && tier < numTiers - 1)
+        next = tier + 1;
+    else if (belowFor >= stepUpSeconds && tier > 0)
+        next = tier - 1;
+
+    if (next != tier) {
+        // the hold gives the average time to settle on what the new tier costs
+        tier = next;
+        sinceChange = 0.0;
+        belowFor = 0.0;
+    }
+    return tier;
+}
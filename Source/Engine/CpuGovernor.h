@@ -0,0 +1,50 @@
+/*
+  ==============================================================================
+
+    CpuGovernor.h
+    Created: 21 May 2023 4:12:08pm
+    Author:  Onez
+
+    Decides which quality tier the engine runs at from how long each block
+    took against its real-time budget (its length at the sample rate).
+    The load is averaged over averagingSeconds. Above stepDownLoad it goes
+    one tier down, below stepUpLoad for stepUpSeconds one tier up, and it
+    never moves twice within holdSeconds, so a cheaper tier's lower load
+    is not mistaken for headroom straight away. Tier 0 is full quality.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+class CpuGovernor
+{
+public:
+    // numTiers >= 1, starts at tier 0
+    void prepare (double newSampleRate, int newNumTiers) noexcept;
+    void reset() noexcept;
+    // shares of the budget, stepUpLoad should stay below half of stepDownLoad since every tier is
+    // about half the cost of the one above
+    void setThresholds (float newStepDownLoad, float newStepUpLoad) noexcept;
+
+    // one block took elapsedSeconds, returns the tier the next one should run at
+    int update (double elapsedSeconds, int numSamples) noexcept;
+
+    int getTier() const noexcept      { return tier; }
+    // averaged share of the budget, 1 = the whole block length
+    float getLoad() const noexcept    { return (float)load; }
+
+    static constexpr double averagingSeconds = 0.25;
+    static constexpr double holdSeconds = 1.0;
+    static constexpr double stepUpSeconds = 3.0;
+
+private:
+    double sampleRate = 44100.0;
+    int numTiers = 1;
+    int tier = 0;
+    double load = 0.0;
+    double sinceChange = 0.0;
+    double belowFor = 0.0;
+    float stepDownLoad = 0.5f;
+    float stepUpLoad = 0.2f;
+};
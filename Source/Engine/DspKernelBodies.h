@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    DspKernelBodies.h
+    Created: 11 Jun 2023 4:05:37pm
+    Author:  Onez
+
+    The loops behind DspKernels. No include guard on purpose: DspKernels.cpp
+    includes this once per instruction set, each time inside its own
+    namespace and target region, and the compiler vectorises each copy for
+    that target. Plain loops only, every element on its own, so all the
+    copies compute exactly the same values. The Exact ones call libm, which
+    the compiler does not vectorise without -ffast-math, so they match the
+    scalar code they replaced bit for bit.
+
+  ==============================================================================
+*/
+
+static void window (const float* window, const float* input, std::complex<float>* output, int count) noexcept
+{
+    float* bins = reinterpret_cast<float*> (output);
+    for (int i = 0; i < count; ++i) {
+        bins[2 * i] = window[i] * input[i];
+        bins[2 * i + 1] = 0.0f;
+    }
+}
+
+static void overlapAdd (float* destination, const float* source, int sourceStride, float scale, int count) noexcept
+{
+    if (sourceStride == 1) {
+        for (int i = 0; i < count; ++i)
+            destination[i] += source[i] * scale;
+    } else {
+        for (int i = 0; i < count; ++i)
+            destination[i] += source[(size_t)i * sourceStride] * scale;
+    }
+}
+
+static void interpolate (const float* y0, const float* y1, const float* y2, const float* y3, float t, float* output, int count) noexcept
+{
+    // STFT::cubicInterpolation (), term for term
+    for (int i = 0; i < count; ++i) {
+        const float a0 = y3[i] - y2[i] - y0[i] + y1[i];
+        const float a1 = y0[i] - y1[i] - a0;
+        const float a2 = y2[i] - y0[i];
+        const float a3 = y1[i];
+        output[i] = a0 * t * t * t + a1 * t * t + a2 * t + a3;
+    }
+}
+
+static void scalePhasors (const float* amplitude, const float* phasorRe, const float* phasorIm, std::complex<float>* output, int count) noexcept
+{
+    float* bins = reinterpret_cast<float*> (output);
+    for (int i = 0; i < count; ++i) {
+        bins[2 * i] = amplitude[i] * phasorRe[i];
+        bins[2 * i + 1] = amplitude[i] * phasorIm[i];
+    }
+}
+
+static void magnitudeDb (const float* re, const float* im, float* magnitude, int* repairs, int count) noexcept
+{
+    for (int i = 0; i < count; ++i) {
+        const float power = re[i] * re[i] + im[i] * im[i];
+        repairs[i] += power >= SpectralGuard::powerFloor ? 0 : 1;
+        magnitude[i] = 10.0f * LaneMath::log10 (power);
+    }
+}
+
+static void polarToCartesian (const float* envelopeDb, const float* phase, float noise, float taper, float* re, float* im, int count) noexcept
+{
+    for (int i = 0; i < count; ++i) {
+        float sine, cosine;
+        LaneMath::sinCos (phase[i], sine, cosine);
+        const float amplitude = (LaneMath::exp (envelopeDb[i] / 20.0f) + noise) * taper;
+        re[i] = amplitude * cosine;
+        im[i] = amplitude * sine;
+    }
+}
+
+static void magnitudeDbExact (const float* re, const float* im, int stride, float* magnitude, int count) noexcept
+{
+    // the double log10 the scalar loops took, so the output does not change
+    for (int i = 0; i < count; ++i) {
+        const std::complex<float> value (re[(size_t)i * stride], im[(size_t)i * stride]);
+        magnitude[i] = (float)(20.0 * std::log10 ((double)std::abs (value)));
+    }
+}
+
+static void amplitudeExact (const float* envelopeDb, float* amplitude, int count) noexcept
+{
+    for (int i = 0; i < count; ++i)
+        amplitude[i] = (float)std::exp (envelopeDb[i] / 20.0);
+}
+
+static void polarToCartesianExact (const float* amplitude, const float* phase, float* re, float* im, int stride, int count) noexcept
+{
+    for (int i = 0; i < count; ++i) {
+        re[(size_t)i * stride] = amplitude[i] * std::cos (phase[i]);
+        im[(size_t)i * stride] = amplitude[i] * std::sin (phase[i]);
+    }
+}
+
+static void applyGain (float* data, int stride, float gain, int count) noexcept
+{
+    if (stride == 1) {
+        for (int i = 0; i < count; ++i)
+            data[i] *= gain;
+    } else {
+        for (int i = 0; i < count; ++i)
+            data[(size_t)i * stride] *= gain;
+    }
+}
+
+static void applyGainRamp (float* data, int stride, float start, float increment, int count) noexcept
+{
+    if (stride == 1) {
+        for (int i = 0; i < count; ++i)
+            data[i] *= start + increment * (float)(i + 1);
+    } else {
+        for (int i = 0; i < count; ++i)
+            data[(size_t)i * stride] *= start + increment * (float)(i + 1);
+    }
+}
+
+static void slide (const float* input, int inputStride, const float* oldest, int numSamples,
+                   const double* rotationRe, const double* rotationIm, const double* twiddleRe, const double* twiddleIm,
+                   double* stateRe, double* stateIm, int count) noexcept
+{
+    for (int sample = 0; sample < numSamples; ++sample) {
+        const double newest = input[(size_t)sample * inputStride];
+        const double removed = oldest[sample];
+        for (int i = 0; i < count; ++i) {
+            const double re = stateRe[i] - removed;
+            const double im = stateIm[i];
+            stateRe[i] = rotationRe[i] * re - rotationIm[i] * im + newest * twiddleRe[i];
+            stateIm[i] = rotationRe[i] * im + rotationIm[i] * re + newest * twiddleIm[i];
+        }
+    }
+}
+
+static const DspKernels table {
+    window, overlapAdd, interpolate, scalePhasors, magnitudeDb, polarToCartesian,
+    magnitudeDbExact, amplitudeExact, polarToCartesianExact, applyGain, applyGainRamp, slide
+};
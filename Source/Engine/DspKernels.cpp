@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    DspKernels.cpp
+    Created: 11 Jun 2023 4:05:37pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "DspKernels.h"
+#include "LaneMath.h"
+#include "SpectralGuard.h"
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+// a fused multiply-add rounds once instead of twice, and only some of the tables could use it
+#if defined (__clang__)
+ #pragma clang fp contract (off)
+#elif defined (__GNUC__)
+ #pragma GCC optimize ("fp-contract=off")
+#endif
+
+#if (defined (__x86_64__) || defined (__i386__)) && defined (__GNUC__)
+ #define STOCSYNTH_ISA_DISPATCH 1
+#else
+ #define STOCSYNTH_ISA_DISPATCH 0
+#endif
+
+namespace sse2
+{
+    #include "DspKernelBodies.h"
+}
+
+#if STOCSYNTH_ISA_DISPATCH
+ #if defined (__clang__)
+  #pragma clang attribute push (__attribute__ ((target ("avx2"))), apply_to = function)
+ #else
+  #pragma GCC push_options
+  #pragma GCC target ("avx2")
+ #endif
+namespace avx2
+{
+    #include "DspKernelBodies.h"
+}
+ #if defined (__clang__)
+  #pragma clang attribute pop
+  #pragma clang attribute push (__attribute__ ((target ("avx512f,avx512vl,avx512dq,avx512bw"))), apply_to = function)
+ #else
+  #pragma GCC pop_options
+  #pragma GCC push_options
+  #pragma GCC target ("avx512f,avx512vl,avx512dq,avx512bw", "prefer-vector-width=512")
+ #endif
+namespace avx512
+{
+    #include "DspKernelBodies.h"
+}
+ #if defined (__clang__)
+  #pragma clang attribute pop
+ #else
+  #pragma GCC pop_options
+ #endif
+#endif
+
+//==============================================================================
+namespace
+{
+    const DspKernels* const tables[DspKernels::numIsas] {
+        &sse2::table,
+#if STOCSYNTH_ISA_DISPATCH
+        &avx2::table,
+        &avx512::table,
+#else
+        &sse2::table,
+        &sse2::table,
+#endif
+    };
+
+    // STOCSYNTH_ISA caps what get () picks, to test the lower tables on a newer machine
+    DspKernels::Isa getRequestedIsa() noexcept
+    {
+        const char* requested = std::getenv ("STOCSYNTH_ISA");
+        for (int isa = 0; requested != nullptr && isa < DspKernels::numIsas; ++isa)
+            if (std::strcmp (requested, DspKernels::getIsaName ((DspKernels::Isa)isa)) == 0)
+                return (DspKernels::Isa)isa;
+        return DspKernels::isaAvx512;
+    }
+
+    DspKernels::Isa limitToCpu (DspKernels::Isa isa) noexcept
+    {
+        const DspKernels::Isa supported = DspKernels::getSupportedIsa();
+        return isa < DspKernels::isaSse2 ? DspKernels::isaSse2 : (isa < supported ? isa : supported);
+    }
+
+    std::atomic<int>& currentIsa() noexcept
+    {
+        static std::atomic<int> isa { (int)limitToCpu (getRequestedIsa()) };
+        return isa;
+    }
+}
+
+DspKernels::Isa DspKernels::getSupportedIsa() noexcept
+{
+#if STOCSYNTH_ISA_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512vl")
+        && __builtin_cpu_supports ("avx512dq") && __builtin_cpu_supports ("avx512bw"))
+        return isaAvx512;
+    if (__builtin_cpu_supports ("avx2"))
+        return isaAvx2;
+#endif
+    return isaSse2;
+}
+
+DspKernels::Isa DspKernels::setIsa (Isa isa) noexcept
+{
+    const Isa chosen = limitToCpu (isa);
+    currentIsa().store ((int)chosen, std::memory_order_relaxed);
+    return chosen;
+}
+
+DspKernels::Isa DspKernels::getIsa() noexcept
+{
+    return (Isa)currentIsa().load (std::memory_order_relaxed);
+}
+
+const DspKernels& DspKernels::get() noexcept
+{
+    return *tables[getIsa()];
+}
+
+const char* DspKernels::getIsaName (Isa isa) noexcept
+{
+    static const char* const names[numIsas] { "sse2", "avx2", "avx512" };
+    return isa >= 0 && isa < numIsas ? names[isa] : "";
+}
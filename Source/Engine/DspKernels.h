@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    DspKernels.h
+    Created: 11 Jun 2023 4:05:37pm
+    Author:  Onez
+
+    The per-sample and per-bin loops the STFT and Gain_Block spend their
+    time in, compiled once per instruction set (SSE2, AVX2, AVX-512) into
+    tables of function pointers. get () picks the best table the CPU
+    supports the first time it is called. Every table does the same
+    arithmetic in the same order without FMA, so the output does not
+    depend on the machine. The lane kernels use LaneMath and the Exact
+    ones call libm, so only the channel lanes trade accuracy for speed.
+    STOCSYNTH_ISA=sse2 / avx2 / avx512 in the
+    environment, or setIsa (), asks for a lower one, for testing.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <complex>
+
+struct DspKernels
+{
+    enum Isa { isaSse2 = 0, isaAvx2, isaAvx512, numIsas };
+
+    // output[i] = window[i] * input[i] + 0i, for analysis ()
+    void (*window) (const float* window, const float* input, std::complex<float>* output, int count) noexcept;
+    // destination[i] += source[i * sourceStride] * scale, for synthesis ()
+    void (*overlapAdd) (float* destination, const float* source, int sourceStride, float scale, int count) noexcept;
+    // output[i] = cubic through y0[i] .. y3[i] at t, STFT::cubicInterpolation () for each i
+    void (*interpolate) (const float* y0, const float* y1, const float* y2, const float* y3, float t, float* output, int count) noexcept;
+    // output[i] = amplitude[i] * (phasorRe[i] + i phasorIm[i]), the phasor resynthesis
+    void (*scalePhasors) (const float* amplitude, const float* phasorRe, const float* phasorIm, std::complex<float>* output, int count) noexcept;
+    // channel lanes, with LaneMath: 10 log10 (re^2 + im^2), a repair counted where the power is under SpectralGuard's floor
+    void (*magnitudeDb) (const float* re, const float* im, float* magnitude, int* repairs, int count) noexcept;
+    // channel lanes, with LaneMath: (e^(envelope / 20) + noise) * taper at phase, into re / im
+    void (*polarToCartesian) (const float* envelopeDb, const float* phase, float noise, float taper, float* re, float* im, int count) noexcept;
+    // the same with libm, for everything but the lanes: 20 log10 |re[i * stride] + i im[i * stride]| without the floor
+    // (SpectralGuard::clampDb () after), e^(envelope / 20) in double, and amplitude at phase into re / im
+    void (*magnitudeDbExact) (const float* re, const float* im, int stride, float* magnitude, int count) noexcept;
+    void (*amplitudeExact) (const float* envelopeDb, float* amplitude, int count) noexcept;
+    void (*polarToCartesianExact) (const float* amplitude, const float* phase, float* re, float* im, int stride, int count) noexcept;
+    // data[i * stride] *= gain, and the ramp start + increment * (i + 1)
+    void (*applyGain) (float* data, int stride, float gain, int count) noexcept;
+    void (*applyGainRamp) (float* data, int stride, float start, float increment, int count) noexcept;
+    // STFT::updateSlidingDft (), one sample at a time: state[i] = rotation[i] * (state[i] - oldest) + input * twiddle[i]
+    void (*slide) (const float* input, int inputStride, const float* oldest, int numSamples,
+                   const double* rotationRe, const double* rotationIm, const double* twiddleRe, const double* twiddleIm,
+                   double* stateRe, double* stateIm, int count) noexcept;
+
+    // the table in use, picked on the first call (not on the audio thread then)
+    static const DspKernels& get() noexcept;
+    static Isa getIsa() noexcept;
+    static const char* getIsaName (Isa isa) noexcept;
+    // the best of isa and what the CPU has, for whatever picks up its table afterwards (STFT and
+    // Gain_Block do in prepare). Returns the one now in use
+    static Isa setIsa (Isa isa) noexcept;
+    static Isa getSupportedIsa() noexcept;
+};
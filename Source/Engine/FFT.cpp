@@ -0,0 +1,321 @@
+/*
+  ==============================================================================
+
+    FFT.cpp
+    Created: 2 Apr 2023 4:12:05pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "FFT.h"
+#include <algorithm>
+#include <cmath>
+
+static std::vector<int> makeBitReversalTable (int order)
+{
+    std::vector<int> table ((size_t)1 << order);
+    for (int i = 0; i < (int)table.size(); ++i) {
+        int reversed = 0;
+        for (int bit = 0; bit < order; ++bit)
+            reversed |= ((i >> bit) & 1) << (order - 1 - bit);
+        table[i] = reversed;
+    }
+    return table;
+}
+
+//==============================================================================
+// One stage of butterflies, the ones of size 2 * half
+static inline void butterflyStage (const std::complex<float>* twiddles, std::complex<float>* output, bool inverse,
+                                   int length, int half, int twiddleStride) noexcept
+{
+    for (int start = 0; start < length; start += 2 * half) {
+        for (int k = 0; k < half; ++k) {
+            // plain real arithmetic, std::complex operator* drags in the NaN-recovery path
+            const float wr = twiddles[k * twiddleStride].real();
+            const float wi = inverse ? -twiddles[k * twiddleStride].imag() : twiddles[k * twiddleStride].imag();
+            const float xr = output[start + k + half].real();
+            const float xi = output[start + k + half].imag();
+            const std::complex<float> odd (wr * xr - wi * xi, wr * xi + wi * xr);
+            output[start + k + half] = output[start + k] - odd;
+            output[start + k] += odd;
+        }
+    }
+}
+
+static inline void batchButterflyStage (const std::complex<float>* twiddles, float* real, float* imag, size_t count, bool inverse,
+                                        int length, int half, int twiddleStride) noexcept
+{
+    for (int start = 0; start < length; start += 2 * half) {
+        for (int k = 0; k < half; ++k) {
+            // the same operations as butterflyStage (), one transform per lane
+            const float wr = twiddles[k * twiddleStride].real();
+            const float wi = inverse ? -twiddles[k * twiddleStride].imag() : twiddles[k * twiddleStride].imag();
+            float* evenRe = real + (start + k) * count;
+            float* evenIm = imag + (start + k) * count;
+            float* oddRe = real + (start + k + half) * count;
+            float* oddIm = imag + (start + k + half) * count;
+
+            for (size_t t = 0; t < count; ++t) {
+                const float xr = oddRe[t];
+                const float xi = oddIm[t];
+                const float re = wr * xr - wi * xi;
+                const float im = wr * xi + wi * xr;
+                oddRe[t] = evenRe[t] - re;
+                oddIm[t] = evenIm[t] - im;
+                evenRe[t] += re;
+                evenIm[t] += im;
+            }
+        }
+    }
+}
+
+// Every stage of a transform of Length with its own instantiation, so each has fixed trip counts the compiler
+// can unroll (the first ones completely) and vectorise. Same operations in the same order as the runtime loop
+template <int Length, int Half, int TwiddleStride>
+static void fixedStages (const std::complex<float>* twiddles, std::complex<float>* output, bool inverse) noexcept
+{
+    butterflyStage (twiddles, output, inverse, Length, Half, TwiddleStride);
+    if constexpr (2 * Half < Length)
+        fixedStages<Length, 2 * Half, TwiddleStride / 2> (twiddles, output, inverse);
+}
+
+template <int Length, int Half, int TwiddleStride>
+static void fixedBatchStages (const std::complex<float>* twiddles, float* real, float* imag, size_t count, bool inverse) noexcept
+{
+    batchButterflyStage (twiddles, real, imag, count, inverse, Length, Half, TwiddleStride);
+    if constexpr (2 * Half < Length)
+        fixedBatchStages<Length, 2 * Half, TwiddleStride / 2> (twiddles, real, imag, count, inverse);
+}
+
+// Length 0 is any length, taken from the call
+template <int Length, int TwiddleStep>
+static void butterflyStages (const std::complex<float>* twiddles, std::complex<float>* output, bool inverse,
+                             int length, int twiddleStep) noexcept
+{
+    if constexpr (Length > 0) {
+        fixedStages<Length, 1, TwiddleStep * Length / 2> (twiddles, output, inverse);
+    } else {
+        for (int half = 1, twiddleStride = twiddleStep * length / 2; half < length; half *= 2, twiddleStride /= 2)
+            butterflyStage (twiddles, output, inverse, length, half, twiddleStride);
+    }
+}
+
+template <int Length, int TwiddleStep>
+static void batchButterflyStages (const std::complex<float>* twiddles, float* real, float* imag, size_t count, bool inverse,
+                                  int length, int twiddleStep) noexcept
+{
+    if constexpr (Length > 0) {
+        fixedBatchStages<Length, 1, TwiddleStep * Length / 2> (twiddles, real, imag, count, inverse);
+    } else {
+        for (int half = 1, twiddleStride = twiddleStep * length / 2; half < length; half *= 2, twiddleStride /= 2)
+            batchButterflyStage (twiddles, real, imag, count, inverse, length, half, twiddleStride);
+    }
+}
+
+// FFT sizes 64 .. 16384 (StocSynthEngine::isValidConfiguration ()) with a twiddle step of 1, and
+// their halves for performRealInverse () with a step of 2, picked once by the constructor
+template <int TwiddleStep>
+static FFT::Butterflies pickButterflies (int length) noexcept
+{
+    switch (length) {
+        case 32:    return butterflyStages<32, TwiddleStep>;
+        case 64:    return butterflyStages<64, TwiddleStep>;
+        case 128:   return butterflyStages<128, TwiddleStep>;
+        case 256:   return butterflyStages<256, TwiddleStep>;
+        case 512:   return butterflyStages<512, TwiddleStep>;
+        case 1024:  return butterflyStages<1024, TwiddleStep>;
+        case 2048:  return butterflyStages<2048, TwiddleStep>;
+        case 4096:  return butterflyStages<4096, TwiddleStep>;
+        case 8192:  return butterflyStages<8192, TwiddleStep>;
+        case 16384: return butterflyStages<16384, TwiddleStep>;
+        default:    return butterflyStages<0, 0>;
+    }
+}
+
+template <int TwiddleStep>
+static FFT::BatchButterflies pickBatchButterflies (int length) noexcept
+{
+    switch (length) {
+        case 32:    return batchButterflyStages<32, TwiddleStep>;
+        case 64:    return batchButterflyStages<64, TwiddleStep>;
+        case 128:   return batchButterflyStages<128, TwiddleStep>;
+        case 256:   return batchButterflyStages<256, TwiddleStep>;
+        case 512:   return batchButterflyStages<512, TwiddleStep>;
+        case 1024:  return batchButterflyStages<1024, TwiddleStep>;
+        case 2048:  return batchButterflyStages<2048, TwiddleStep>;
+        case 4096:  return batchButterflyStages<4096, TwiddleStep>;
+        case 8192:  return batchButterflyStages<8192, TwiddleStep>;
+        case 16384: return batchButterflyStages<16384, TwiddleStep>;
+        default:    return batchButterflyStages<0, 0>;
+    }
+}
+
+//==============================================================================
+FFT::FFT (int newOrder)
+    : order (newOrder), size (1 << newOrder),
+      butterflies (pickButterflies<1> (size)), halfButterflies (pickButterflies<2> (size / 2)),
+      batchButterflies (pickBatchButterflies<1> (size)), halfBatchButterflies (pickBatchButterflies<2> (size / 2))
+{
+    twiddles.resize (size / 2);
+    for (int i = 0; i < size / 2; ++i) {
+        const double angle = -2.0 * M_PI * (double)i / (double)size;
+        twiddles[i] = { (float)std::cos (angle), (float)std::sin (angle) };
+    }
+
+    bitReversed = makeBitReversalTable (order);
+    halfBitReversed = makeBitReversalTable (order > 0 ? order - 1 : 0);
+}
+
+void FFT::perform (const std::complex<float>* input, std::complex<float>* output, bool inverse) const noexcept
+{
+    transform (input, output, inverse, size, bitReversed.data(), 1);
+
+    if (inverse) {
+        const float scale = 1.0f / (float)size;
+        for (int i = 0; i < size; ++i)
+            output[i] *= scale;
+    }
+}
+
+void FFT::performRealInverse (const std::complex<float>* spectrum, float* output, int numNonZeroBins,
+                              std::complex<float>* scratch) const noexcept
+{
+    // Two real half-length signals packed into one complex one: the even samples come from
+    // X[k] + conj (X[M - k]), the odd ones from (X[k] - conj (X[M - k])) * e^(2 pi i k / N).
+    // Bins at or above numNonZeroBins are treated as zero and never read.
+    const int half = size / 2;
+    const int numBins = std::min (std::max (numNonZeroBins, 0), half + 1);
+    auto bin = [&] (int k) { return k < numBins ? spectrum[k] : std::complex<float> (0.0f, 0.0f); };
+
+    // DC and Nyquist only keep their real parts, like the real part of a full complex inverse
+    const float dc = bin (0).real();
+    const float nyquist = bin (half).real();
+    scratch[0] = { 0.5f * (dc + nyquist), 0.5f * (dc - nyquist) };
+
+    for (int k = 1; k < half; ++k) {
+        if (k >= numBins && half - k >= numBins) {
+            scratch[k] = { 0.0f, 0.0f };
+            continue;
+        }
+
+        const std::complex<float> a = bin (k);
+        const std::complex<float> b = std::conj (bin (half - k));
+        const float sumRe = a.real() + b.real(), sumIm = a.imag() + b.imag();
+        const float diffRe = a.real() - b.real(), diffIm = a.imag() - b.imag();
+        // e^(+2 pi i k / N) is the conjugate of the forward twiddle
+        const float wr = twiddles[k].real(), wi = -twiddles[k].imag();
+        const float oddRe = diffRe * wr - diffIm * wi;
+        const float oddIm = diffRe * wi + diffIm * wr;
+        scratch[k] = { 0.5f * (sumRe - oddIm), 0.5f * (sumIm + oddRe) };
+    }
+
+    // z[m] = (x[2m], x[2m + 1]), which is exactly the layout of a float array
+    auto* packed = reinterpret_cast<std::complex<float>*> (output);
+    transform (scratch, packed, true, half, halfBitReversed.data(), 2);
+
+    const float scale = 1.0f / (float)half;
+    for (int i = 0; i < half; ++i)
+        packed[i] *= scale;
+}
+
+void FFT::performBatch (float* real, float* imag, int numTransforms, bool inverse) const noexcept
+{
+    const size_t count = (size_t)numTransforms;
+    transformBatch (real, imag, count, inverse, size, bitReversed.data(), 1);
+
+    if (inverse) {
+        const float scale = 1.0f / (float)size;
+        for (size_t i = 0; i < (size_t)size * count; ++i) {
+            real[i] *= scale;
+            imag[i] *= scale;
+        }
+    }
+}
+
+void FFT::performRealInverseBatch (float* real, const float* imag, int numTransforms, int numNonZeroBins,
+                                   float* scratchReal, float* scratchImag) const noexcept
+{
+    // performRealInverse () with every step running across the transforms
+    const size_t count = (size_t)numTransforms;
+    const int half = size / 2;
+    const int numBins = std::min (std::max (numNonZeroBins, 0), half + 1);
+
+    for (size_t t = 0; t < count; ++t) {
+        const float dc = numBins > 0 ? real[t] : 0.0f;
+        const float nyquist = half < numBins ? real[half * count + t] : 0.0f;
+        scratchReal[t] = 0.5f * (dc + nyquist);
+        scratchImag[t] = 0.5f * (dc - nyquist);
+    }
+
+    for (int k = 1; k < half; ++k) {
+        float* outRe = scratchReal + k * count;
+        float* outIm = scratchImag + k * count;
+        const bool hasA = k < numBins, hasB = half - k < numBins;
+        if (! hasA && ! hasB) {
+            std::fill (outRe, outRe + count, 0.0f);
+            std::fill (outIm, outIm + count, 0.0f);
+            continue;
+        }
+
+        const float* aRe = real + k * count;
+        const float* aIm = imag + k * count;
+        const float* bRe = real + (half - k) * count;
+        const float* bIm = imag + (half - k) * count;
+        const float wr = twiddles[k].real(), wi = -twiddles[k].imag();
+
+        for (size_t t = 0; t < count; ++t) {
+            const float ar = hasA ? aRe[t] : 0.0f, ai = hasA ? aIm[t] : 0.0f;
+            // conj (X[half - k])
+            const float br = hasB ? bRe[t] : 0.0f, bi = hasB ? -bIm[t] : -0.0f;
+            const float sumRe = ar + br, sumIm = ai + bi;
+            const float diffRe = ar - br, diffIm = ai - bi;
+            const float oddRe = diffRe * wr - diffIm * wi;
+            const float oddIm = diffRe * wi + diffIm * wr;
+            outRe[t] = 0.5f * (sumRe - oddIm);
+            outIm[t] = 0.5f * (sumIm + oddRe);
+        }
+    }
+
+    transformBatch (scratchReal, scratchImag, count, true, half, halfBitReversed.data(), 2);
+
+    const float scale = 1.0f / (float)half;
+    for (int m = 0; m < half; ++m) {
+        float* even = real + (2 * m) * count;
+        float* odd = real + (2 * m + 1) * count;
+        const float* zRe = scratchReal + m * count;
+        const float* zIm = scratchImag + m * count;
+        for (size_t t = 0; t < count; ++t) {
+            even[t] = zRe[t] * scale;
+            odd[t] = zIm[t] * scale;
+        }
+    }
+}
+
+void FFT::transformBatch (float* real, float* imag, size_t count, bool inverse,
+                          int length, const int* reversal, int twiddleStep) const noexcept
+{
+    for (int i = 0; i < length; ++i) {
+        if (i < reversal[i]) {
+            std::swap_ranges (real + i * count, real + (i + 1) * count, real + reversal[i] * count);
+            std::swap_ranges (imag + i * count, imag + (i + 1) * count, imag + reversal[i] * count);
+        }
+    }
+
+    (length == size ? batchButterflies : halfBatchButterflies) (twiddles.data(), real, imag, count, inverse, length, twiddleStep);
+}
+
+void FFT::transform (const std::complex<float>* input, std::complex<float>* output, bool inverse,
+                     int length, const int* reversal, int twiddleStep) const noexcept
+{
+    if (input == output) {
+        for (int i = 0; i < length; ++i)
+            if (i < reversal[i])
+                std::swap (output[i], output[reversal[i]]);
+    } else {
+        for (int i = 0; i < length; ++i)
+            output[reversal[i]] = input[i];
+    }
+
+    (length == size ? butterflies : halfButterflies) (twiddles.data(), output, inverse, length, twiddleStep);
+}
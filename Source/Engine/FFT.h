@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    FFT.h
+    Created: 2 Apr 2023 4:12:05pm
+    Author:  Onez
+
+    Small radix-2 complex FFT so the engine builds without juce_dsp.
+    Same calling convention as juce::dsp::FFT::perform (), including the
+    1/N scaling on the inverse transform.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class FFT
+{
+public:
+    explicit FFT (int order);
+
+    int getSize() const noexcept { return size; }
+
+    void perform (const std::complex<float>* input, std::complex<float>* output, bool inverse) const noexcept;
+
+    // Inverse of a conjugate symmetric spectrum, given as bins 0 .. size / 2, into size real samples
+    // with one half size complex transform. Bins from numNonZeroBins on are taken as zero.
+    // scratch holds size / 2 values and belongs to the caller, so one FFT can be shared between threads.
+    void performRealInverse (const std::complex<float>* spectrum, float* output, int numNonZeroBins,
+                             std::complex<float>* scratch) const noexcept;
+
+    // numTransforms transforms in place, stored as separate real / imaginary planes with the
+    // transforms interleaved: sample k of transform t is at [k * numTransforms + t].
+    // Every butterfly then runs across the transforms, and gives the same result as perform ().
+    void performBatch (float* real, float* imag, int numTransforms, bool inverse) const noexcept;
+    // performRealInverse () on the same layout: bins 0 .. size / 2 of real / imag in, size real samples
+    // per transform out in real. The scratch planes hold size / 2 * numTransforms values each.
+    void performRealInverseBatch (float* real, const float* imag, int numTransforms, int numNonZeroBins,
+                                  float* scratchReal, float* scratchImag) const noexcept;
+
+    // the butterfly stages of a transform of one length, compiled for each FFT size (see FFT.cpp)
+    using Butterflies = void (*) (const std::complex<float>* twiddles, std::complex<float>* data, bool inverse,
+                                  int length, int twiddleStep) noexcept;
+    using BatchButterflies = void (*) (const std::complex<float>* twiddles, float* real, float* imag, size_t count,
+                                       bool inverse, int length, int twiddleStep) noexcept;
+
+private:
+    void transform (const std::complex<float>* input, std::complex<float>* output, bool inverse,
+                    int length, const int* reversal, int twiddleStep) const noexcept;
+    void transformBatch (float* real, float* imag, size_t count, bool inverse,
+                         int length, const int* reversal, int twiddleStep) const noexcept;
+
+    int order;
+    int size;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<int> bitReversed;
+    std::vector<int> halfBitReversed;
+    // full size and half size (performRealInverse ()) stages
+    Butterflies butterflies, halfButterflies;
+    BatchButterflies batchButterflies, halfBatchButterflies;
+};
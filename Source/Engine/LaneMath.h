@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    LaneMath.h
+    Created: 30 Apr 2023 2:47:10pm
+    Author:  Onez
+
+    Branch-free float approximations of the few libm functions the STFT
+    needs per bin, so a loop across channel lanes calling them is turned
+    into SSE / AVX code by the compiler instead of one libm call per lane.
+    Accurate to a few ulp over the ranges the STFT feeds them, not for
+    infinities, NaN or denormals. The selects are written so that GCC and
+    Clang can if-convert them without -fno-trapping-math.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace LaneMath
+{
+    inline float asFloat (int32_t bits) noexcept { float value; std::memcpy (&value, &bits, sizeof (value)); return value; }
+    inline int32_t asInt (float value) noexcept  { int32_t bits; std::memcpy (&bits, &value, sizeof (bits)); return bits; }
+
+    // nearest integer, halves away from zero, |x| < 2^31
+    inline int32_t roundToInt (float x) noexcept { return (int32_t)(x + (x >= 0.0f ? 0.5f : -0.5f)); }
+
+    // x >= 0, anything below 1e-30 counts as 1e-30 (-600 dB on a power)
+    inline float log10 (float x) noexcept
+    {
+        // positive floats order like their bit patterns, and an integer select never gets turned into a branch
+        const int32_t tinyBits = 0x0da24260; // 1e-30f
+        const int32_t bits = asInt (x) > tinyBits ? asInt (x) : tinyBits;
+        // split so the mantissa lands in [sqrt (1/2), sqrt (2)), then ln m = 2 atanh ((m - 1) / (m + 1))
+        const int32_t exponent = (bits - 0x3f3504f3) >> 23;
+        const float mantissa = asFloat (bits - exponent * 0x800000);
+
+        const float t = (mantissa - 1.0f) / (mantissa + 1.0f);
+        const float t2 = t * t;
+        const float lnMantissa = 2.0f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f + t2 * (1.0f / 9.0f)))));
+        return ((float)exponent * 0.693147181f + lnMantissa) * 0.434294482f;
+    }
+
+    // |x| < 87
+    inline float exp (float x) noexcept
+    {
+        const int32_t n = roundToInt (x * 1.44269504f);
+        // ln 2 in two parts (Cody & Waite), n * 0.693359375 is exact
+        const float r = (x - (float)n * 0.693359375f) + (float)n * 2.12194440e-4f;
+        const float p = 1.0f + r * (1.0f + r * (0.5f + r * (1.0f / 6.0f + r * (1.0f / 24.0f + r * (1.0f / 120.0f + r * (1.0f / 720.0f))))));
+        return p * asFloat ((n + 127) << 23);
+    }
+
+    // Abramowitz & Stegun 4.4.49 on [0, 1], |error| < 2e-8, then folded into the right octant
+    inline float atan2 (float y, float x) noexcept
+    {
+        const float ax = x < 0.0f ? -x : x;
+        const float ay = y < 0.0f ? -y : y;
+        const float largest = ax > ay ? ax : ay;
+        const float a = (ax < ay ? ax : ay) / (largest > 1.0e-30f ? largest : 1.0e-30f);
+        const float s = a * a;
+
+        float angle = a * (0.9999993329f + s * (-0.3332985605f + s * (0.1994653599f + s * (-0.1390853351f
+                    + s * (0.0964200441f + s * (-0.0559098861f + s * (0.0218612288f + s * -0.0040540580f)))))));
+        // offset + sign * angle, only constants get selected so the compiler can use blends
+        angle = (ay > ax ? 1.57079633f : 0.0f) + (ay > ax ? -1.0f : 1.0f) * angle;
+        angle = (x < 0.0f ? 3.14159265f : 0.0f) + (x < 0.0f ? -1.0f : 1.0f) * angle;
+        return (y < 0.0f ? -1.0f : 1.0f) * angle;
+    }
+
+    // both at once, they share the range reduction to [-pi/4, pi/4]; |x| up to a few thousand
+    inline void sinCos (float x, float& sine, float& cosine) noexcept
+    {
+        const int32_t quadrant = roundToInt (x * 0.636619772f);
+        // pi / 2 in three parts, the first two products are exact
+        const float q = (float)quadrant;
+        const float r = ((x - q * 1.5703125f) - q * 4.83751297e-4f) - q * 7.54978995e-8f;
+        const float r2 = r * r;
+
+        const float s = r * (1.0f + r2 * (-1.0f / 6.0f + r2 * (1.0f / 120.0f + r2 * (-1.0f / 5040.0f + r2 * (1.0f / 362880.0f)))));
+        const float c = 1.0f + r2 * (-0.5f + r2 * (1.0f / 24.0f + r2 * (-1.0f / 720.0f + r2 * (1.0f / 40320.0f))));
+
+        const bool swap = (quadrant & 1) != 0;
+        const float sinValue = swap ? c : s;
+        const float cosValue = swap ? s : c;
+        sine = (quadrant & 2) != 0 ? -sinValue : sinValue;
+        cosine = ((quadrant + 1) & 2) != 0 ? -cosValue : cosValue;
+    }
+
+    // y > 0 and |x / y| < 2^31, sign of x like std::fmod
+    inline float fmod (float x, float y) noexcept
+    {
+        return x - y * (float)(int32_t)(x / y);
+    }
+}
@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    NoiseFilterBank.cpp
+    Created: 28 May 2023 10:41:55am
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "NoiseFilterBank.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // xorshift32 as a signed integer, to uniform noise of unit power
+    constexpr float noiseScale = 1.7320508f / 2147483648.0f;
+
+    // one sample of every band: voices gets gain * filtered noise, then the gains move on
+    void step (uint32_t* __restrict noise, const float* __restrict b0, const float* __restrict b1, const float* __restrict b2,
+               const float* __restrict a1, const float* __restrict a2, float* __restrict state1, float* __restrict state2,
+               float* __restrict gain, const float* __restrict gainStep, float* __restrict voices, int numLanes) noexcept
+    {
+        for (int index = 0; index < numLanes; ++index) {
+            uint32_t bits = noise[index];
+            bits ^= bits << 13;
+            bits ^= bits >> 17;
+            bits ^= bits << 5;
+            noise[index] = bits;
+            const float input = (float)(int32_t)bits * noiseScale;
+
+            const float output = b0[index] * input + state1[index];
+            state1[index] = b1[index] * input - a1[index] * output + state2[index];
+            state2[index] = b2[index] * input - a2[index] * output;
+            voices[index] = gain[index] * output;
+            gain[index] += gainStep[index];
+        }
+    }
+}
+
+//==============================================================================
+void NoiseFilterBank::prepare (double sampleRate, int newNumBands)
+{
+    numBands = std::min (maxBands, std::max (minBands, newNumBands));
+    numLanes = (numBands + laneWidth - 1) / laneWidth * laneWidth;
+    const size_t lanes = (size_t)numLanes;
+    sampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+    const double nyquist = 0.5 * sampleRate;
+
+    edges.assign ((size_t)numBands + 1, 0.0);
+    const double ratio = std::pow (nyquist / lowestEdge, 1.0 / (numBands - 1));
+    for (int band = 1; band < numBands; ++band)
+        edges[(size_t)band] = lowestEdge * std::pow (ratio, band - 1);
+    edges[(size_t)numBands] = nyquist;
+
+    b0.assign (lanes, 0.0f);
+    b1.assign (lanes, 0.0f);
+    b2.assign (lanes, 0.0f);
+    a1.assign (lanes, 0.0f);
+    a2.assign (lanes, 0.0f);
+    for (int band = 0; band < numBands; ++band) {
+        // RBJ cookbook: low pass and high pass at the outer edges (Q 1 / sqrt 2), band passes across the rest
+        const double lower = edges[(size_t)band], upper = edges[(size_t)band + 1];
+        const bool lowPass = band == 0, highPass = band == numBands - 1;
+        const double centre = lowPass ? upper : highPass ? lower : std::sqrt (lower * upper);
+        const double omega = 2.0 * M_PI * centre / sampleRate;
+        const double cosine = std::cos (omega), sine = std::sin (omega);
+        const double alpha = lowPass || highPass
+                           ? sine / std::sqrt (2.0)
+                           : sine * std::sinh (0.5 * std::log (2.0) * std::log2 (upper / lower) * omega / sine);
+
+        double coefficients[5];
+        if (lowPass)
+            coefficients[0] = coefficients[2] = 0.5 * (1.0 - cosine), coefficients[1] = 1.0 - cosine;
+        else if (highPass)
+            coefficients[0] = coefficients[2] = 0.5 * (1.0 + cosine), coefficients[1] = -(1.0 + cosine);
+        else
+            coefficients[0] = alpha, coefficients[1] = 0.0, coefficients[2] = -alpha;
+        coefficients[3] = -2.0 * cosine;
+        coefficients[4] = 1.0 - alpha;
+        for (double& coefficient : coefficients)
+            coefficient /= 1.0 + alpha;
+
+        // the energy of the impulse response is the output power for unit white noise, scale it to 1
+        double energy = 0.0, state1 = 0.0, state2 = 0.0;
+        for (int sample = 0; sample < 1 << 16; ++sample) {
+            const double input = sample == 0 ? 1.0 : 0.0;
+            const double output = coefficients[0] * input + state1;
+            state1 = coefficients[1] * input - coefficients[3] * output + state2;
+            state2 = coefficients[2] * input - coefficients[4] * output;
+            energy += output * output;
+        }
+        const double normalise = 1.0 / std::sqrt (std::max (energy, 1.0e-30));
+
+        b0[(size_t)band] = (float)(coefficients[0] * normalise);
+        b1[(size_t)band] = (float)(coefficients[1] * normalise);
+        b2[(size_t)band] = (float)(coefficients[2] * normalise);
+        a1[(size_t)band] = (float)coefficients[3];
+        a2[(size_t)band] = (float)coefficients[4];
+    }
+
+    state1.assign (lanes, 0.0f);
+    state2.assign (lanes, 0.0f);
+    noise.assign (lanes, 0u);
+    gain.assign (lanes, 0.0f);
+    gainStep.assign (lanes, 0.0f);
+    target.assign (lanes, 0.0f);
+    voices.assign (lanes, 0.0f);
+    reset();
+}
+
+void NoiseFilterBank::reset() noexcept
+{
+    std::fill (state1.begin(), state1.end(), 0.0f);
+    std::fill (state2.begin(), state2.end(), 0.0f);
+    std::fill (gain.begin(), gain.end(), 0.0f);
+    std::fill (gainStep.begin(), gainStep.end(), 0.0f);
+    std::fill (target.begin(), target.end(), 0.0f);
+    // a different sequence per band, never 0
+    for (size_t lane = 0; lane < noise.size(); ++lane)
+        noise[lane] = 0x9e3779b9u * (uint32_t)(lane + 1);
+    rampRemaining = 0;
+    silent = true;
+}
+
+void NoiseFilterBank::setTargets (const float* gains, int rampLength) noexcept
+{
+    rampLength = std::max (1, rampLength);
+    silent = false;
+    for (int band = 0; band < numBands; ++band) {
+        target[(size_t)band] = gains[band];
+        gainStep[(size_t)band] = (gains[band] - gain[(size_t)band]) / (float)rampLength;
+    }
+    rampRemaining = rampLength;
+}
+
+void NoiseFilterBank::render (float* output, int numSamples, int stride) noexcept
+{
+    for (int done = 0; done < numSamples;) {
+        if (silent) {
+            for (int sample = done; sample < numSamples; ++sample)
+                output[(size_t)sample * stride] = 0.0f;
+            return;
+        }
+
+        // up to the end of the ramp, then steady until the next setTargets ()
+        const int length = rampRemaining > 0 ? std::min (numSamples - done, rampRemaining) : numSamples - done;
+        advance (length, output + (size_t)done * stride, stride);
+        done += length;
+
+        if (rampRemaining > 0 && (rampRemaining -= length) == 0) {
+            bool audible = false;
+            for (int band = 0; band < numBands; ++band) {
+                gain[(size_t)band] = target[(size_t)band];
+                gainStep[(size_t)band] = 0.0f;
+                audible = audible || target[(size_t)band] != 0.0f;
+            }
+            silent = ! audible;
+        }
+    }
+}
+
+void NoiseFilterBank::saveState (StateWriter& writer) const
+{
+    writer.write (state1);
+    writer.write (state2);
+    writer.write (noise);
+    writer.write (gain);
+    writer.write (gainStep);
+    writer.write (target);
+    writer.write (rampRemaining);
+    writer.write (silent);
+}
+
+void NoiseFilterBank::loadState (StateReader& reader) noexcept
+{
+    reader.read (state1);
+    reader.read (state2);
+    reader.read (noise);
+    reader.read (gain);
+    reader.read (gainStep);
+    reader.read (target);
+    reader.read (rampRemaining);
+    reader.read (silent);
+}
+
+void NoiseFilterBank::advance (int numSamples, float* output, int stride) noexcept
+{
+    for (int sample = 0; sample < numSamples; ++sample) {
+        step (noise.data(), b0.data(), b1.data(), b2.data(), a1.data(), a2.data(), state1.data(), state2.data(),
+              gain.data(), gainStep.data(), voices.data(), numLanes);
+
+        // laneWidth partial sums instead of one, so this runs across whole vectors as well
+        float sums[laneWidth];
+        std::copy (voices.begin(), voices.begin() + laneWidth, sums);
+        for (int group = laneWidth; group < numLanes; group += laneWidth)
+            for (int lane = 0; lane < laneWidth; ++lane)
+                sums[lane] += voices[(size_t)(group + lane)];
+
+        float total = 0.0f;
+        for (const float sum : sums)
+            total += sum;
+        output[(size_t)sample * stride] = total;
+    }
+}
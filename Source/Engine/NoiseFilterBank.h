@@ -0,0 +1,65 @@
+/*
+  ==============================================================================
+
+    NoiseFilterBank.h
+    Created: 28 May 2023 10:41:55am
+    Author:  Onez
+
+    Stochastic synthesis in the time domain: every band is its own white
+    noise through a biquad (low pass, band passes, high pass), normalised
+    to unit output power and scaled by the band's gain, which ramps
+    linearly to each new target. No transform and no frame, so the cost
+    only depends on the number of bands. Like OscillatorBank every sample
+    is one loop across all the bands, in whole vectors.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "StateBlob.h"
+
+class NoiseFilterBank
+{
+public:
+    static constexpr int laneWidth = 8;
+    static constexpr int minBands = 4;
+    static constexpr int maxBands = 64;
+    // the first band is a low pass up to here, the inner edges are spaced geometrically from it to Nyquist
+    static constexpr double lowestEdge = 50.0;
+
+    // numBands (clamped to minBands .. maxBands) from 0 Hz to Nyquist, all silent. Allocates
+    void prepare (double sampleRate, int numBands);
+    // silences every band and clears the filters
+    void reset() noexcept;
+    int getNumBands() const noexcept { return numBands; }
+    // lower edge of a band in Hz, getBandEdge (getNumBands ()) is Nyquist
+    double getBandEdge (int band) const noexcept { return edges[(size_t)band]; }
+
+    // the RMS every band reaches, linearly over the next rampLength samples
+    void setTargets (const float* gains, int rampLength) noexcept;
+    // numSamples of the sum of the bands into output[sample * stride]
+    void render (float* output, int numSamples, int stride) noexcept;
+
+    // filters, noise generators and gains, into a bank prepared the same way
+    void saveState (StateWriter& writer) const;
+    void loadState (StateReader& reader) noexcept;
+
+private:
+    void advance (int numSamples, float* output, int stride) noexcept;
+
+    int numBands = 0;
+    // numBands rounded up to whole lanes, the extra bands have no gain
+    int numLanes = 0;
+    std::vector<double> edges;
+    // transposed direct form II, y = b0 x + s1, s1 = b1 x - a1 y + s2, s2 = b2 x - a2 y
+    std::vector<float> b0, b1, b2, a1, a2, state1, state2;
+    std::vector<uint32_t> noise;
+    std::vector<float> gain, gainStep, target;
+    std::vector<float> voices;
+    int rampRemaining = 0;
+    // every gain is 0 and stays 0, render () only writes zeros
+    bool silent = true;
+};
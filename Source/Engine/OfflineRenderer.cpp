@@ -0,0 +1,290 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.cpp
+    Created: 7 May 2023 10:24:51am
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "OfflineRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    // run (worker, task) for every task, worker 0 is the calling thread
+    void runWorkStealing (int numTasks, int numWorkers, const std::function<void (int, int)>& run)
+    {
+        std::vector<TaskQueue> queues ((size_t)numWorkers);
+        // contiguous slices, so neighbouring chunks stay on one thread until somebody steals them
+        for (int task = 0; task < numTasks; ++task)
+            queues[(size_t)((int64_t)task * numWorkers / numTasks)].tasks.push_back (task);
+
+        auto next = [&] (int worker, int& task) {
+            for (int offset = 0; offset < numWorkers; ++offset) {
+                TaskQueue& queue = queues[(size_t)((worker + offset) % numWorkers)];
+                std::lock_guard<std::mutex> guard (queue.lock);
+                if (queue.tasks.empty())
+                    continue;
+
+                // own work from the front, stolen work from the back
+                task = offset == 0 ? queue.tasks.front() : queue.tasks.back();
+                if (offset == 0)
+                    queue.tasks.pop_front();
+                else
+                    queue.tasks.pop_back();
+                return true;
+            }
+            return false;
+        };
+        auto work = [&] (int worker) {
+            int task = 0;
+            while (next (worker, task))
+                run (worker, task);
+        };
+
+        std::vector<std::thread> threads;
+        for (int worker = 1; worker < numWorkers; ++worker) {
+            try {
+                threads.emplace_back (work, worker);
+            } catch (const std::system_error&) {
+                // fewer threads, the ones running steal the missing ones' queues
+                break;
+            }
+        }
+        work (0);
+        for (auto& thread : threads)
+            thread.join();
+    }
+}
+
+//==============================================================================
+OfflineRenderer::OfflineRenderer (const std::function<void (STFT&)>& configureWorker, int numThreads)
+{
+    if (numThreads <= 0)
+        numThreads = std::max (1, (int)std::thread::hardware_concurrency());
+
+    workers.resize ((size_t)numThreads);
+    for (Worker& worker : workers) {
+        worker.stft = std::make_unique<STFT>();
+        worker.stft->setup (1);
+        configureWorker (*worker.stft);
+    }
+
+    fftSize = workers.front().stft->getFftSize();
+    overlap = workers.front().stft->getOverlap();
+    hopSize = fftSize / overlap;
+    const size_t numBins = (size_t)fftSize / 2 + 1;
+    for (Worker& worker : workers) {
+        worker.frame.assign ((size_t)fftSize, 0.0f);
+        worker.window.assign ((size_t)fftSize, 0.0f);
+        worker.envelopes.assign (2 * numBins, 0.0f);
+        worker.envelope.assign (numBins, 0.0f);
+    }
+}
+
+OfflineRenderer::~OfflineRenderer()
+{
+}
+
+void OfflineRenderer::render (float* data, int64_t numSamples, uint64_t seed)
+{
+    if (numSamples <= 0 || fftSize <= 0)
+        return;
+
+    // the frames ending at or after numSamples add nothing to the file. In place is fine, a group's
+    // output is only written once the next group, the last one to read that input, is rendered
+    overlapAdd (data, numSamples, (numSamples - 1) / hopSize, [&] (Worker& worker, int64_t frame, float* samples) {
+        return worker.stft->renderFrame (getWindow (worker, data, numSamples, (frame + 1) * hopSize), samples, seed + (uint64_t)frame);
+    });
+}
+
+void OfflineRenderer::renderStretched (const float* input, int64_t numInputSamples, float* output, int64_t numOutputSamples,
+                                       double stretch, uint64_t seed)
+{
+    if (numOutputSamples <= 0 || fftSize <= 0 || ! (stretch > 0.0))
+        return;
+
+    for (Worker& worker : workers)
+        worker.envelopeFrames[0] = worker.envelopeFrames[1] = -1;
+
+    const size_t numBins = (size_t)fftSize / 2 + 1;
+    overlapAdd (output, numOutputSamples, (numOutputSamples - 1) / hopSize, [&] (Worker& worker, int64_t frame, float* samples) {
+        // the input frame index this output frame lands on, analysis frame j ends on (j + 1) * hopSize too
+        const double position = (double)(frame + 1) / stretch - 1.0;
+        const int64_t before = (int64_t)std::floor (position);
+        const float fraction = (float)(position - (double)before);
+        const float* first = getEnvelope (worker, input, numInputSamples, before);
+        const float* second = getEnvelope (worker, input, numInputSamples, before + 1);
+
+        // silent if the nearer analysis frame is, the other one alone if only that one is live
+        const float* envelope = fraction < 0.5f ? first : second;
+        if (envelope == nullptr)
+            return false;
+        if (first != nullptr && second != nullptr) {
+            for (size_t bin = 0; bin < numBins; ++bin)
+                worker.envelope[bin] = first[bin] + fraction * (second[bin] - first[bin]);
+            envelope = worker.envelope.data();
+        }
+
+        worker.stft->synthesiseEnvelope (envelope, seed + (uint64_t)frame * 0x100000001b3ull, samples);
+        return true;
+    });
+}
+
+//==============================================================================
+void OfflineRenderer::overlapAdd (float* output, int64_t numSamples, int64_t numFrames, const FrameSource& source)
+{
+    // chunks need at least `overlap` frames, so only neighbours share a seam
+    const int chunkFrames = std::max (framesPerChunk, overlap);
+    const int64_t numChunks = (numFrames + chunkFrames - 1) / chunkFrames;
+    const int chunksPerGroup = (int)workers.size() * chunksPerThread;
+    if (numChunks == 0) {
+        std::fill (output, output + numSamples, 0.0f);
+        return;
+    }
+
+    // each group is finished while the next one is already rendered, see render ()
+    std::vector<Chunk> rendering, finishing;
+    int64_t finishingFirstChunk = 0;
+    Chunk previous;
+    bool hasPrevious = false;
+
+    auto finishGroup = [&] {
+        for (size_t index = 0; index < finishing.size(); ++index) {
+            const Chunk& chunk = finishing[index];
+            const bool lastChunk = finishingFirstChunk + (int64_t)index == numChunks - 1;
+            const int64_t ownedEnd = lastChunk ? numSamples : chunk.firstEnd + (int64_t)chunk.numFrames * hopSize;
+            const Chunk* before = index > 0 ? &finishing[index - 1] : (hasPrevious ? &previous : nullptr);
+            finishChunk (chunk, before, output, ownedEnd);
+        }
+
+        // the next group's first seam still needs the last sums
+        std::swap (previous, finishing.back());
+        hasPrevious = true;
+    };
+
+    for (int64_t firstChunk = 0; firstChunk < numChunks; firstChunk += chunksPerGroup) {
+        const int groupChunks = (int)std::min<int64_t> (chunksPerGroup, numChunks - firstChunk);
+        rendering.resize ((size_t)groupChunks);
+
+        for (int index = 0; index < groupChunks; ++index) {
+            Chunk& chunk = rendering[(size_t)index];
+            chunk.firstFrame = (firstChunk + index) * chunkFrames;
+            chunk.firstEnd = (chunk.firstFrame + 1) * hopSize;
+            chunk.numFrames = (int)std::min<int64_t> (chunkFrames, numFrames - chunk.firstFrame);
+
+            // sized here, a bad_alloc on a worker thread would terminate
+            const int numHeads = std::min (overlap - 1, chunk.numFrames);
+            chunk.sum.assign ((size_t)(chunk.numFrames - 1) * hopSize + fftSize, 0.0f);
+            chunk.heads.resize ((size_t)numHeads * fftSize);
+            chunk.headSilent.assign ((size_t)numHeads, 1);
+        }
+
+        runWorkStealing (groupChunks, (int)std::min<size_t> (workers.size(), (size_t)groupChunks), [&] (int worker, int task) {
+            renderChunk (workers[(size_t)worker], rendering[(size_t)task], source);
+        });
+
+        if (! finishing.empty())
+            finishGroup();
+        std::swap (rendering, finishing);
+        finishingFirstChunk = firstChunk;
+    }
+    finishGroup();
+}
+
+void OfflineRenderer::renderChunk (Worker& worker, Chunk& chunk, const FrameSource& source)
+{
+    const int numHeads = (int)chunk.headSilent.size();
+    // where the previous chunk's last frame ends, the heads' parts before it are summed in finishChunk ()
+    const int64_t seamEnd = chunk.firstEnd - hopSize + fftSize;
+
+    for (int frame = 0; frame < chunk.numFrames; ++frame) {
+        const int64_t end = chunk.firstEnd + (int64_t)frame * hopSize;
+        const bool head = frame < numHeads;
+        float* samples = head ? chunk.heads.data() + (size_t)frame * fftSize : worker.frame.data();
+
+        if (! source (worker, chunk.firstFrame + frame, samples))
+            continue;
+        if (head)
+            chunk.headSilent[(size_t)frame] = 0;
+
+        // same additions in the same order as synthesis () into the output ring
+        const int first = head ? (int)(seamEnd - end) : 0;
+        float* destination = chunk.sum.data() + (end - chunk.firstEnd);
+        for (int index = first; index < fftSize; ++index)
+            destination[index] += samples[index];
+    }
+}
+
+void OfflineRenderer::finishChunk (const Chunk& chunk, const Chunk* previous, float* output, int64_t ownedEnd) const
+{
+    // before the first frame ends the output ring is still empty
+    if (previous == nullptr)
+        std::fill (output, output + std::min (chunk.firstEnd, ownedEnd), 0.0f);
+
+    const int numHeads = (int)chunk.headSilent.size();
+    const int64_t seamEnd = std::min (ownedEnd, chunk.firstEnd - hopSize + fftSize);
+
+    // the seam: what the previous chunk summed, then the heads in frame order
+    for (int64_t sample = chunk.firstEnd; sample < seamEnd; ++sample) {
+        float value = previous != nullptr ? previous->sum[(size_t)(sample - previous->firstEnd)] : 0.0f;
+        for (int frame = 0; frame < numHeads; ++frame) {
+            const int64_t end = chunk.firstEnd + (int64_t)frame * hopSize;
+            if (! chunk.headSilent[(size_t)frame] && sample >= end)
+                value += chunk.heads[(size_t)frame * fftSize + (size_t)(sample - end)];
+        }
+        output[sample] = value;
+    }
+
+    // past the last frame of the file the ring only holds zeros
+    const int64_t summedEnd = std::min (ownedEnd, chunk.firstEnd + (int64_t)chunk.sum.size());
+    for (int64_t sample = seamEnd; sample < summedEnd; ++sample)
+        output[sample] = chunk.sum[(size_t)(sample - chunk.firstEnd)];
+    for (int64_t sample = std::max (seamEnd, summedEnd); sample < ownedEnd; ++sample)
+        output[sample] = 0.0f;
+}
+
+//==============================================================================
+const float* OfflineRenderer::getWindow (Worker& worker, const float* input, int64_t numSamples, int64_t end) const
+{
+    const int64_t start = end - fftSize;
+    if (start >= 0 && end <= numSamples)
+        return input + start;
+
+    for (int index = 0; index < fftSize; ++index) {
+        const int64_t sample = start + index;
+        worker.window[(size_t)index] = sample >= 0 && sample < numSamples ? input[sample] : 0.0f;
+    }
+    return worker.window.data();
+}
+
+const float* OfflineRenderer::getEnvelope (Worker& worker, const float* input, int64_t numSamples, int64_t frame) const
+{
+    // before the file starts it is silent
+    if (frame < 0)
+        return nullptr;
+
+    const size_t numBins = (size_t)fftSize / 2 + 1;
+    const int slot = (int)(frame & 1);
+    float* envelope = worker.envelopes.data() + (size_t)slot * numBins;
+
+    if (worker.envelopeFrames[slot] != frame) {
+        const float* window = getWindow (worker, input, numSamples, (frame + 1) * hopSize);
+        worker.envelopeLive[slot] = worker.stft->analyseEnvelope (window, envelope);
+        worker.envelopeFrames[slot] = frame;
+    }
+    return worker.envelopeLive[slot] ? envelope : nullptr;
+}
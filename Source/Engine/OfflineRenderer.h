@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    OfflineRenderer.h
+    Created: 7 May 2023 10:24:51am
+    Author:  Onez
+
+    Runs the STFT over a whole file on several threads. The frames are cut
+    into chunks, each worker takes chunks from the front of its own queue
+    and steals from the back of the others once it runs dry. Every chunk
+    overlap-adds into its own buffer and keeps the frames that reach into
+    the previous chunk apart, so the seams can be summed afterwards in
+    frame order: the output is bit-identical to STFT::processBlock () over
+    the same file, whatever the thread count or the scheduling.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "STFT.h"
+
+class OfflineRenderer
+{
+public:
+    // configureWorker gets a fresh single channel STFT per thread and sets it up like the one being
+    // replaced (updateParameters () and every parameter setter). numThreads <= 0: one per core
+    OfflineRenderer (const std::function<void (STFT&)>& configureWorker, int numThreads);
+    ~OfflineRenderer();
+
+    // in place, what processBlock () would leave in data without the output gain. seed picks the
+    // phasors if the STFT uses them (e.g. one per channel), frame j gets seed + j
+    void render (float* data, int64_t numSamples, uint64_t seed = 0);
+
+    // Stochastic time stretch (SMS style): envelopes are analysed every hop of the input, interpolated
+    // in dB to where each output hop lands (input time = output time / stretch) and resynthesised with
+    // new random phases, so there is no phase tracking at all. output gets numOutputSamples samples,
+    // input sample t comes out around t * stretch + fftSize * (1 + stretch) / 2 (one frame at 1x).
+    // seed picks the random phases (e.g. one per channel)
+    void renderStretched (const float* input, int64_t numInputSamples, float* output, int64_t numOutputSamples,
+                          double stretch, uint64_t seed);
+
+    int getNumThreads() const noexcept { return (int)workers.size(); }
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<STFT> stft;
+        std::vector<float> frame;
+        // a frame's input with zeros outside the file
+        std::vector<float> window;
+        // renderStretched (): the last two analysed envelopes, in slot frame & 1, and the interpolated one
+        std::vector<float> envelopes;
+        std::vector<float> envelope;
+        int64_t envelopeFrames[2] = { -1, -1 };
+        bool envelopeLive[2] = { false, false };
+    };
+
+    // frame `frame` (ending on (frame + 1) * hopSize) into samples, false if it adds nothing
+    using FrameSource = std::function<bool (Worker&, int64_t frame, float* samples)>;
+
+    // numFrames consecutive frames, the first one ending on output sample firstEnd
+    struct Chunk
+    {
+        int64_t firstFrame = 0;
+        int64_t firstEnd = 0;
+        int numFrames = 0;
+        // all frames overlap-added from firstEnd on, except where the heads overlap the previous chunk
+        std::vector<float> sum;
+        // the first overlap - 1 frames as they are, they reach back into the previous chunk
+        std::vector<float> heads;
+        std::vector<char> headSilent;
+    };
+
+    // the frames from source overlap-added into output, in frame order like the output ring does it
+    void overlapAdd (float* output, int64_t numSamples, int64_t numFrames, const FrameSource& source);
+    void renderChunk (Worker& worker, Chunk& chunk, const FrameSource& source);
+    void finishChunk (const Chunk& chunk, const Chunk* previous, float* output, int64_t ownedEnd) const;
+
+    const float* getWindow (Worker& worker, const float* input, int64_t numSamples, int64_t end) const;
+    const float* getEnvelope (Worker& worker, const float* input, int64_t numSamples, int64_t frame) const;
+
+    // chunks of a few hundred milliseconds, and a few per thread so stealing can even them out
+    static constexpr int framesPerChunk = 64;
+    static constexpr int chunksPerThread = 8;
+
+    std::vector<Worker> workers;
+    int fftSize = 0;
+    int overlap = 0;
+    int hopSize = 0;
+
+    OfflineRenderer (const OfflineRenderer&) = delete;
+    OfflineRenderer& operator= (const OfflineRenderer&) = delete;
+};
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    OscillatorBank.cpp
+    Created: 14 May 2023 11:02:36am
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "OscillatorBank.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // one sample of every oscillator: voices gets gain * sin, then the phasors, their rotations and the gains move on
+    void advance (float* __restrict zRe, float* __restrict zIm, float* __restrict wRe, float* __restrict wIm,
+                  const float* __restrict dRe, const float* __restrict dIm, float* __restrict gain,
+                  const float* __restrict gainStep, float* __restrict voices, int numOscillators) noexcept
+    {
+        for (int index = 0; index < numOscillators; ++index) {
+            voices[index] = gain[index] * zIm[index];
+
+            const float re = zRe[index] * wRe[index] - zIm[index] * wIm[index];
+            const float im = zRe[index] * wIm[index] + zIm[index] * wRe[index];
+            zRe[index] = re;
+            zIm[index] = im;
+            const float rotationRe = wRe[index] * dRe[index] - wIm[index] * dIm[index];
+            const float rotationIm = wRe[index] * dIm[index] + wIm[index] * dRe[index];
+            wRe[index] = rotationRe;
+            wIm[index] = rotationIm;
+            gain[index] += gainStep[index];
+        }
+    }
+}
+
+//==============================================================================
+void OscillatorBank::prepare (int numOscillators, int maxBlockSize)
+{
+    const size_t capacity = (size_t)(std::max (0, numOscillators) + laneWidth - 1) / laneWidth * laneWidth;
+    phaseRe.assign (capacity, 1.0f);
+    phaseIm.assign (capacity, 0.0f);
+    frequency.assign (capacity, 0.0f);
+    amplitude.assign (capacity, 0.0f);
+    targetFrequency.assign (capacity, 0.0f);
+    targetAmplitude.assign (capacity, 0.0f);
+    rotationRe.assign (capacity, 1.0f);
+    rotationIm.assign (capacity, 0.0f);
+    sweepRe.assign (capacity, 1.0f);
+    sweepIm.assign (capacity, 0.0f);
+    gain.assign (capacity, 0.0f);
+    gainStep.assign (capacity, 0.0f);
+    voices.assign (capacity, 0.0f);
+    laneSums.assign ((size_t)std::max (0, maxBlockSize) * laneWidth, 0.0f);
+    activeEnd = 0;
+}
+
+void OscillatorBank::reset()
+{
+    std::fill (phaseRe.begin(), phaseRe.end(), 1.0f);
+    std::fill (phaseIm.begin(), phaseIm.end(), 0.0f);
+    std::fill (amplitude.begin(), amplitude.end(), 0.0f);
+    std::fill (targetAmplitude.begin(), targetAmplitude.end(), 0.0f);
+    activeEnd = 0;
+}
+
+void OscillatorBank::saveState (StateWriter& writer) const
+{
+    writer.write (phaseRe);
+    writer.write (phaseIm);
+    writer.write (frequency);
+    writer.write (amplitude);
+    writer.write (targetFrequency);
+    writer.write (targetAmplitude);
+    writer.write (activeEnd);
+}
+
+void OscillatorBank::loadState (StateReader& reader) noexcept
+{
+    reader.read (phaseRe);
+    reader.read (phaseIm);
+    reader.read (frequency);
+    reader.read (amplitude);
+    reader.read (targetFrequency);
+    reader.read (targetAmplitude);
+    reader.read (activeEnd);
+}
+
+void OscillatorBank::start (int index, float newFrequency) noexcept
+{
+    phaseRe[index] = 1.0f;
+    phaseIm[index] = 0.0f;
+    frequency[index] = targetFrequency[index] = newFrequency;
+    amplitude[index] = targetAmplitude[index] = 0.0f;
+}
+
+void OscillatorBank::setTarget (int index, float newFrequency, float newAmplitude) noexcept
+{
+    targetFrequency[index] = newFrequency;
+    targetAmplitude[index] = newAmplitude;
+    if (newAmplitude != 0.0f)
+        activeEnd = std::max (activeEnd, index + 1);
+}
+
+void OscillatorBank::render (float* output, int numSamples) noexcept
+{
+    numSamples = std::min (numSamples, (int)(laneSums.size() / laneWidth));
+    if (numSamples <= 0 || activeEnd == 0)
+        return;
+
+    // whole groups, the oscillators past activeEnd are silent and stay silent
+    const int numOscillators = (activeEnd + laneWidth - 1) / laneWidth * laneWidth;
+    const float rampScale = 1.0f / (float)numSamples;
+
+    // the per sample rotation w = e^(i f) and the rotation of that, d = e^(i df)
+    for (int index = 0; index < numOscillators; ++index) {
+        const float step = (targetFrequency[index] - frequency[index]) * rampScale;
+        rotationRe[index] = std::cos (frequency[index]);
+        rotationIm[index] = std::sin (frequency[index]);
+        sweepRe[index] = std::cos (step);
+        sweepIm[index] = std::sin (step);
+        gain[index] = amplitude[index];
+        gainStep[index] = (targetAmplitude[index] - amplitude[index]) * rampScale;
+    }
+
+    for (int sample = 0; sample < numSamples; ++sample) {
+        advance (phaseRe.data(), phaseIm.data(), rotationRe.data(), rotationIm.data(), sweepRe.data(), sweepIm.data(),
+                 gain.data(), gainStep.data(), voices.data(), numOscillators);
+
+        // laneWidth partial sums instead of one, so this runs across whole vectors as well
+        float* sums = laneSums.data() + (size_t)sample * laneWidth;
+        std::copy (voices.begin(), voices.begin() + laneWidth, sums);
+        for (int group = laneWidth; group < numOscillators; group += laneWidth)
+            for (int lane = 0; lane < laneWidth; ++lane)
+                sums[lane] += voices[(size_t)(group + lane)];
+    }
+
+    // back on the unit circle once a hop, the rounding errors of the products add up otherwise
+    int lastAudible = 0;
+    for (int index = 0; index < numOscillators; ++index) {
+        const float norm = 1.0f / std::sqrt (phaseRe[index] * phaseRe[index] + phaseIm[index] * phaseIm[index]);
+        phaseRe[index] *= norm;
+        phaseIm[index] *= norm;
+        frequency[index] = targetFrequency[index];
+        amplitude[index] = targetAmplitude[index];
+        if (amplitude[index] != 0.0f)
+            lastAudible = index + 1;
+    }
+    activeEnd = lastAudible;
+
+    for (int sample = 0; sample < numSamples; ++sample) {
+        const float* sums = laneSums.data() + (size_t)sample * laneWidth;
+        float total = 0.0f;
+        for (int lane = 0; lane < laneWidth; ++lane)
+            total += sums[lane];
+        output[sample] += total;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+  ==============================================================================
+
+    OscillatorBank.h
+    Created: 14 May 2023 11:02:36am
+    Author:  Onez
+
+    Additive sine oscillators for the deterministic (sinusoidal) part.
+    Every oscillator is a unit phasor rotated once per sample, and its
+    rotation is itself rotated to sweep the frequency, so a hop with a
+    linear frequency and amplitude ramp needs no sin / cos per sample.
+    Every sample is one loop across all the oscillators, which the
+    compiler turns into SSE / AVX code; the bank grows in whole vectors.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <vector>
+#include "StateBlob.h"
+
+class OscillatorBank
+{
+public:
+    static constexpr int laneWidth = 8;
+
+    // room for at least numOscillators, all silent. Allocates
+    void prepare (int numOscillators, int maxBlockSize);
+    // silences every oscillator and puts its phase back to 0
+    void reset();
+    int getCapacity() const noexcept { return (int)frequency.size(); }
+
+    // a silent oscillator at this frequency (radians per sample), phase 0
+    void start (int index, float newFrequency) noexcept;
+    // where the oscillator gets to, linearly, over the next render ()
+    void setTarget (int index, float newFrequency, float newAmplitude) noexcept;
+
+    // adds numSamples (up to maxBlockSize) of every oscillator to output
+    void render (float* output, int numSamples) noexcept;
+
+    // the phasors and parameters, into a bank prepared for the same capacity
+    void saveState (StateWriter& writer) const;
+    void loadState (StateReader& reader) noexcept;
+
+private:
+    // the phasors, current and target parameters, one entry per oscillator
+    std::vector<float> phaseRe, phaseIm;
+    std::vector<float> frequency, amplitude;
+    std::vector<float> targetFrequency, targetAmplitude;
+    // what render () steps per sample, set up from the above at its start
+    std::vector<float> rotationRe, rotationIm, sweepRe, sweepIm;
+    std::vector<float> gain, gainStep;
+    std::vector<float> voices;
+    // [sample][lane], the voices summed laneWidth apart
+    std::vector<float> laneSums;
+    // oscillators from here on are silent and stay silent
+    int activeEnd = 0;
+};
@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    PartialTracker.cpp
+    Created: 14 May 2023 11:02:36am
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "PartialTracker.h"
+#include <algorithm>
+#include <cmath>
+
+void PartialTracker::prepare (int newMaxPartials, int maxBlockSize)
+{
+    maxPartials = std::max (0, newMaxPartials);
+    bank.prepare (2 * maxPartials, maxBlockSize);
+
+    const size_t numSlots = (size_t)bank.getCapacity();
+    state.assign (numSlots, slotFree);
+    slotFrequency.assign (numSlots, 0.0f);
+    matched.assign (numSlots, 0);
+    byFrequency.assign (numSlots, 0);
+    byAmplitude.assign ((size_t)maxPartials, 0);
+}
+
+void PartialTracker::reset()
+{
+    bank.reset();
+    std::fill (state.begin(), state.end(), slotFree);
+}
+
+void PartialTracker::saveState (StateWriter& writer) const
+{
+    bank.saveState (writer);
+    writer.write (state);
+    writer.write (slotFrequency);
+}
+
+void PartialTracker::loadState (StateReader& reader) noexcept
+{
+    bank.loadState (reader);
+    reader.read (state);
+    reader.read (slotFrequency);
+}
+
+int PartialTracker::findPeaks (const float* magnitudeDb, int numBins, float thresholdDb,
+                               Peak* peaks, int maxPeaks, Peak* scratch)
+{
+    int numFound = 0;
+    for (int bin = 1; bin < numBins - 1; ++bin) {
+        const float left = magnitudeDb[bin - 1], centre = magnitudeDb[bin], right = magnitudeDb[bin + 1];
+        if (! (centre > thresholdDb && centre > left && centre >= right))
+            continue;
+
+        // vertex of the parabola through the three bins
+        const float curvature = left - 2.0f * centre + right;
+        const float offset = curvature < 0.0f ? 0.5f * (left - right) / curvature : 0.0f;
+        scratch[numFound++] = { (float)bin + offset, centre - 0.25f * (left - right) * offset };
+    }
+
+    auto louder = [] (const Peak& a, const Peak& b) { return a.magnitudeDb > b.magnitudeDb; };
+    if (numFound > maxPeaks) {
+        std::nth_element (scratch, scratch + maxPeaks, scratch + numFound, louder);
+        numFound = maxPeaks;
+    }
+    std::copy (scratch, scratch + numFound, peaks);
+    return numFound;
+}
+
+void PartialTracker::update (const float* frequencies, const float* amplitudes, int numPeaks, float maxDeviation)
+{
+    numPeaks = std::min (numPeaks, maxPartials);
+    const int numSlots = (int)state.size();
+
+    // the ones that faded out over the last hop are silent now
+    int numActive = 0;
+    for (int slot = 0; slot < numSlots; ++slot) {
+        if (state[slot] == slotEnding)
+            state[slot] = slotFree;
+        matched[slot] = 0;
+        if (state[slot] == slotActive)
+            byFrequency[numActive++] = slot;
+    }
+    std::sort (byFrequency.begin(), byFrequency.begin() + numActive,
+               [this] (int a, int b) { return slotFrequency[a] < slotFrequency[b]; });
+
+    for (int peak = 0; peak < numPeaks; ++peak)
+        byAmplitude[peak] = peak;
+    std::sort (byAmplitude.begin(), byAmplitude.begin() + numPeaks,
+               [amplitudes] (int a, int b) { return amplitudes[a] > amplitudes[b]; });
+
+    // loudest peak first, to the nearest partial that is still free, within maxDeviation
+    for (int rank = 0; rank < numPeaks; ++rank) {
+        const int peak = byAmplitude[rank];
+        const float target = frequencies[peak];
+        const int* first = byFrequency.data();
+        const int* above = std::lower_bound (first, first + numActive, target,
+                                             [this] (int slot, float value) { return slotFrequency[slot] < value; });
+
+        int best = -1;
+        float bestDistance = maxDeviation;
+        for (const int* slot = above; slot < first + numActive && slotFrequency[*slot] - target <= bestDistance; ++slot) {
+            if (! matched[*slot]) {
+                best = *slot;
+                bestDistance = slotFrequency[*slot] - target;
+                break;
+            }
+        }
+        for (const int* slot = above; slot > first && target - slotFrequency[*(slot - 1)] <= bestDistance; --slot) {
+            if (! matched[*(slot - 1)]) {
+                best = *(slot - 1);
+                break;
+            }
+        }
+
+        if (best < 0) {
+            // a new partial in the lowest free slot, nothing left means it is dropped
+            for (int slot = 0; slot < numSlots && best < 0; ++slot)
+                if (state[slot] == slotFree && ! matched[slot])
+                    best = slot;
+            if (best < 0)
+                continue;
+            state[best] = slotActive;
+            bank.start (best, target);
+        }
+
+        matched[best] = 1;
+        slotFrequency[best] = target;
+        bank.setTarget (best, target, amplitudes[peak]);
+    }
+
+    for (int index = 0; index < numActive; ++index) {
+        const int slot = byFrequency[index];
+        if (! matched[slot]) {
+            state[slot] = slotEnding;
+            bank.setTarget (slot, slotFrequency[slot], 0.0f);
+        }
+    }
+}
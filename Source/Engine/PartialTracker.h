@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    PartialTracker.h
+    Created: 14 May 2023 11:02:36am
+    Author:  Onez
+
+    Peak picking and frame to frame tracking for the sinusoidal part.
+    Peaks are local maxima of a dB magnitude spectrum, refined with a
+    parabola through the three bins around them. Each hop the loudest
+    peaks are matched, loudest first, to the nearest partial of the last
+    hop; partials that find no peak fade out over one hop and peaks that
+    find no partial fade in from silence. Nothing allocates after prepare ().
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <vector>
+#include "OscillatorBank.h"
+
+class PartialTracker
+{
+public:
+    struct Peak
+    {
+        float bin;          // fractional
+        float magnitudeDb;  // of the parabola's vertex
+    };
+
+    // room for maxPartials tracks and their oscillators (twice that, the fading ones need theirs for a hop)
+    void prepare (int maxPartials, int maxBlockSize);
+    void reset();
+
+    // Up to maxPeaks local maxima of magnitudeDb[0 .. numBins) above thresholdDb, the loudest ones,
+    // into peaks. Returns how many. scratch needs room for numBins / 2 + 1 peaks
+    static int findPeaks (const float* magnitudeDb, int numBins, float thresholdDb,
+                          Peak* peaks, int maxPeaks, Peak* scratch);
+
+    // one hop: continue, start or end partials from these peaks (frequency in radians per sample,
+    // linear amplitude, amplitude is ignored for matching), then render the hop
+    void update (const float* frequencies, const float* amplitudes, int numPeaks, float maxDeviation);
+    void render (float* output, int numSamples) noexcept { bank.render (output, numSamples); }
+
+    // the tracks and their oscillators, into a tracker prepared the same way
+    void saveState (StateWriter& writer) const;
+    void loadState (StateReader& reader) noexcept;
+
+private:
+    enum SlotState : char { slotFree = 0, slotActive, slotEnding };
+
+    OscillatorBank bank;
+    std::vector<char> state;
+    std::vector<float> slotFrequency;
+    std::vector<char> matched;
+    // active slots by frequency, and peaks by amplitude
+    std::vector<int> byFrequency;
+    std::vector<int> byAmplitude;
+    int maxPartials = 0;
+};
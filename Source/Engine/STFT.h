@@ -0,0 +1,1970 @@
+/*
+  ==============================================================================
+
+    STFT.h
+    Created: 23 Feb 2023 3:18:57pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "DspKernels.h"
+#include "FFT.h"
+#include "LaneMath.h"
+#include "NoiseFilterBank.h"
+#include "PartialTracker.h"
+#include "SpectralGuard.h"
+#include "SpectralNode.h"
+#include "SpectrumTap.h"
+#include "StateBlob.h"
+#include "STFTTables.h"
+#include "Wavetabels.h"
+//==============================================================================
+
+class STFT
+{
+public:
+    enum windowTypeIndex {
+        windowTypeRectangular = 0,
+        windowTypeBartlett,
+        windowTypeHann,
+        windowTypeHamming,
+    };
+
+    //======================================
+
+    STFT() : numChannels (1)
+    {
+    }
+
+    virtual ~STFT()
+    {
+    }
+
+    //======================================
+
+    void setup (const int numInputChannels)
+    {
+        numChannels = (numInputChannels > 0) ? numInputChannels : 1;
+    }
+
+    void updateParameters (const int newFftSize, const int newOverlap, const int newWindowType)
+    {
+        kernels = &DspKernels::get();
+        updateFftSize (newFftSize);
+        updateHopSize (newOverlap);
+        updateWindow (newWindowType);
+        prepareSpectralNodes();
+        allocateSliding();
+        allocateBatch();
+        allocateSinusoids();
+        allocateFilterBank();
+        allocateEnvelopeDecimation();
+    }
+
+    //======================================
+
+    // channelData[channel][sample * stride], so interleaved buffers can be processed in place
+    void processBlock (float* const* channelData, const int numBlockChannels, const int numBlockSamples, const int stride = 1)
+    {
+        numSamples = numBlockSamples;
+        const int channelsToProcess = numBlockChannels < numChannels ? numBlockChannels : numChannels;
+        // with channel lanes every channel goes through the same batches, otherwise one at a time
+        const int channelsPerPass = channelLanes && batchCapacity > 0 ? channelsToProcess : 1;
+
+        for (int channel = 0; channel < channelsToProcess; channel += channelsPerPass) {
+            const int passChannels = std::min (channelsPerPass, channelsToProcess - channel);
+            float* data = channelData[channel];
+            currentInputBufferWritePosition = inputBufferWritePosition;
+            currentOutputBufferWritePosition = outputBufferWritePosition;
+            currentOutputBufferReadPosition = outputBufferReadPosition;
+            currentSamplesSinceLastFFT = samplesSinceLastFFT;
+            currentHopPeakIndex = hopPeakIndex;
+
+            // work in runs up to the next hop, the result is the same as going sample by sample
+            int sample = 0;
+            while (sample < numSamples) {
+                if (passChannels > 1 || (batchCapacity > 0 && (numSamples - sample + currentSamplesSinceLastFFT) / hopSize > 1)) {
+                    sample = processBatch (channelData + channel, channel, passChannels, sample, stride);
+                    continue;
+                }
+
+                const int runLength = std::min (numSamples - sample, hopSize - currentSamplesSinceLastFFT);
+                float* run = data + (size_t)sample * stride;
+
+                if (slidingTerms > 0)
+                    slide (channel, run, runLength, stride);
+                writeInput (channel, run, runLength, stride);
+                if (filterBankBands > 0)
+                    noiseBanks[channel].render (run, runLength, stride);
+                else
+                    readOutput (channel, run, runLength, stride);
+                sample += runLength;
+
+                if ((currentSamplesSinceLastFFT += runLength) >= hopSize) {
+                    currentSamplesSinceLastFFT = 0;
+                    const uint64_t hop = hopCounts[channel]++;
+
+                    const bool silent = isSilentFrame (channel);
+                    if (silent) {
+                        skipFrame (channel);
+                        if (filterBankBands > 0)
+                            noiseBanks[channel].setTargets (silentBands.data(), hopSize);
+                    } else if (filterBankBands > 0) {
+                        if (slidingTerms > 0) {
+                            slidingSpectrum (channel, hop);
+                        } else {
+                            analysis (channel);
+                            fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+                        }
+                        analyseBands();
+                        noiseBanks[channel].setTargets (bandGains.data(), hopSize);
+                    } else {
+                        silentFrames[channel] = 0;
+                        if (phasorPhases)
+                            phasorStart = phasorOffset (((uint64_t)channel << 48) + hop);
+                        // the sliding DFT has the spectrum already, so modification () without its FFT
+                        if (slidingTerms > 0) {
+                            slidingSpectrum (channel, hop);
+                            analyseSpectrum();
+                            resynthesise();
+                        } else if (envelopeHops > 1) {
+                            decimatedModification (channel, hop);
+                        } else {
+                            analysis (channel);
+                            modification();
+                        }
+                        synthesis (channel, synthesisFrame, synthesisFrameStride);
+                    }
+                    countRepairs();
+                    if (sinusoidPartials > 0)
+                        synthesisePartials (channel, silent);
+                    if (telemetryEnabled && channel == 0)
+                        publishSpectrum (silent);
+                    increment (framesTotal);
+                }
+            }
+        }
+
+        inputBufferWritePosition = currentInputBufferWritePosition;
+        outputBufferWritePosition = currentOutputBufferWritePosition;
+        outputBufferReadPosition = currentOutputBufferReadPosition;
+        samplesSinceLastFFT = currentSamplesSinceLastFFT;
+        hopPeakIndex = currentHopPeakIndex;
+    }
+    void updateStochfactor(float newValue){
+        stocfactor = newValue;
+    }
+    void updatedecimation(float newValue){
+        decimation = newValue * 100;
+    }
+    
+    void updatecutoff(float newValue){
+        if (newValue != cutoff)
+            filterKernelDirty = true;
+        cutoff = newValue;
+    }
+    void updateSampleRate(double newSampleRate){
+        sampleRate = (float)newSampleRate;
+        filterKernelDirty = true;
+        if (tables != nullptr) {
+            acquireTables();
+            allocateFilterBank();
+            prepareSpectralNodes();
+            allocateEnvelopeDecimation();
+        }
+    }
+    // publish a snapshot of channel 0 every hop, the cost is the same whether anyone reads it or not
+    void updateTelemetry(bool shouldPublish){
+        telemetryEnabled = shouldPublish;
+    }
+    // reader side of the snapshots, for one consumer on one (non audio) thread
+    SpectrumTap& getSpectrumTap() noexcept { return *spectrumTap; }
+    // publish into another STFT's tap instead, when several take turns feeding one display
+    void useSpectrumTap (SpectrumTap& tap) noexcept { spectrumTap = &tap; }
+    // only resynthesise the bins up to the cutoff, everything above is zeroed (changes the sound)
+    void updateBinPruning(bool shouldPrune){
+        binPruning = shouldPrune;
+    }
+    // frames whose input peak is at or below this (linear) are not transformed at all, 0 = only digital silence
+    void updateSilenceThreshold(float newValue){
+        silenceThreshold = newValue;
+    }
+
+    // Blocks holding several hops get all their frames transformed together instead of one at a time,
+    // with the same output. Allocates, so call it outside the audio thread (setup time).
+    void updateFrameBatching(bool shouldBatch, int newMaxBlockSize){
+        frameBatching = shouldBatch;
+        maxBlockSize = newMaxBlockSize;
+        allocateBatch();
+    }
+    // All channels share every batch, side by side in the vector lanes, and the per-bin work uses
+    // LaneMath instead of libm (differs from the default path by about -100 dB). Allocates like the above.
+    void updateChannelLanes(bool shouldUseLanes){
+        channelLanes = shouldUseLanes;
+        allocateBatch();
+    }
+
+    // Splits every frame into sinusoids and a residual: the maxPartials loudest spectral peaks above
+    // thresholdDb (dBFS of the sine) are tracked from hop to hop and played by an oscillator bank, and
+    // their lobes are taken out of the magnitudes before the stochastic envelope. 0 partials = off.
+    // Needs an overlap of at least 2, and turns frame batching and channel lanes off while it is on.
+    // Allocates, so call it outside the audio thread (setup time).
+    void updateSinusoids(int maxPartials, float thresholdDb){
+        sinusoidMaxPartials = std::max (0, maxPartials);
+        sinusoidThresholdDb = thresholdDb;
+        allocateBatch();
+        allocateSinusoids();
+        allocateEnvelopeDecimation();
+    }
+
+    // Synthesises the stochastic part with numBands filtered noise bands (see NoiseFilterBank) driven by the
+    // envelope of every frame, instead of an inverse FFT. The band gains ramp over a hop and nothing waits
+    // for a frame, so the output has no latency (getLatencySamples ()). 0 = off. Leaves the sinusoids out and
+    // turns frame batching and channel lanes off while it is on. Allocates, so call it outside the audio thread.
+    void updateFilterBank(int numBands){
+        filterBankBands = numBands > 0 ? std::min (NoiseFilterBank::maxBands, std::max (NoiseFilterBank::minBands, numBands)) : 0;
+        allocateBatch();
+        allocateSinusoids();
+        allocateFilterBank();
+        allocateEnvelopeDecimation();
+    }
+    int getLatencySamples() const noexcept { return filterBankBands > 0 ? 0 : fftSize; }
+
+    // Every bin gets its amplitude times a unit phasor from a table of random ones (STFTTables::phasorReal),
+    // instead of the analysed phase smoothed, unwrapped and back through cos / sin: no trigonometry per bin.
+    // inputPhaseBias (0 .. 1) pulls the phasors towards the input's phases, 1 keeps them. The frames no
+    // longer add up in phase, so the level changes (see StocSynthEngine::measureLevel ()). The filter bank
+    // has no phases and ignores it. Off by default
+    void updatePhasors(bool shouldUsePhasors, float inputPhaseBias){
+        phasorPhases = shouldUsePhasors;
+        phasorBias = std::min (1.0f, std::max (0.0f, inputPhaseBias));
+    }
+
+    // High overlap mode, for hops of 8 .. 32 samples: instead of a forward FFT every hop, a sliding DFT
+    // keeps the spectrum of each channel's last fftSize samples up to date one sample at a time, in the
+    // bins that get analysed only (up to the pruned band with bin pruning, otherwise all of them). The
+    // window is applied in the frequency domain, which is exact for the rectangular window and, with two
+    // more resonators per bin 1 / (fftSize - 1) cycles either side, for Hann and Hamming as the tables
+    // define them; Bartlett stays with the FFT. The resonators run in double and start over from an FFT
+    // of the ring every overlap hops, so rounding cannot build up. Cheaper than the FFT once the hop is
+    // short and few bins are analysed. Turns frame batching and channel lanes off while it is on, and
+    // a subclass overriding modification () should leave it off. Allocates, so call it outside the audio thread
+    void updateSlidingDft(bool shouldSlide){
+        slidingDft = shouldSlide;
+        allocateSliding();
+        allocateBatch();
+        allocateEnvelopeDecimation();
+    }
+    bool isSlidingDftActive() const noexcept { return slidingTerms > 0; }
+
+    // Temporal envelope decimation for slowly changing sources: the frames are only analysed every interval
+    // hops (2 .. 16, 1 = every hop, the default), counted from hop 0, and the envelope ramps in dB from the one
+    // played to the new one over the hops until the next analysis. With fluxThreshold > 0 every hop in between
+    // also gets a short frame, fftSize / 8 long, and is analysed straight away (no ramp) if its band levels
+    // moved by more than that share since the last analysis. Every frame gets new random phases from its hop
+    // instead of the analysed ones, like synthesiseEnvelope (), so the noise stays fresh and the level changes
+    // (see StocSynthEngine::measureLevel ()). Leaves out the sinusoids, the filter bank and the sliding DFT,
+    // which need every hop analysed, and turns frame batching and channel lanes off. Allocates, so call it
+    // outside the audio thread
+    void updateEnvelopeDecimation (int interval, float fluxThreshold){
+        envelopeInterval = std::min (maxEnvelopeInterval, std::max (1, interval));
+        envelopeFluxThreshold = std::max (0.0f, fluxThreshold);
+        allocateBatch();
+        allocateEnvelopeDecimation();
+    }
+    // the interval in effect, 1 when off or left out
+    int getEnvelopeDecimation() const noexcept { return envelopeHops; }
+
+    // Spectral nodes after the stochastic resynthesis, one per settings and in that order, see SpectralNode.
+    // They work on the frame resynthesise () leaves for the inverse FFT, so the filter bank, which has none,
+    // goes without them. Turns frame batching and channel lanes off while there are any. Allocates, so call
+    // it outside the audio thread
+    void updateSpectralNodes (const SpectralNode::Settings* settings, int numNodes){
+        spectralNodes.clear();
+        for (int index = 0; index < numNodes; ++index)
+            if (auto node = SpectralNode::create (settings[index].type))
+                spectralNodes.push_back (std::move (node));
+        prepareSpectralNodes();
+        updateSpectralNodeParameters (settings, numNodes);
+        allocateBatch();
+    }
+    // the same settings as updateSpectralNodes (), for the parameters only (audio thread safe)
+    void updateSpectralNodeParameters (const SpectralNode::Settings* settings, int numNodes) noexcept {
+        for (int index = 0; index < numNodes && index < (int)spectralNodes.size(); ++index)
+            for (int parameter = 0; parameter < SpectralNode::maxParameters; ++parameter)
+                spectralNodes[(size_t)index]->setParameter (parameter, settings[index].parameters[parameter]);
+    }
+
+    // frame counters, written by the audio thread and safe to read from any other
+    uint64_t getFrameCount() const noexcept        { return framesTotal.load (std::memory_order_relaxed); }
+    uint64_t getSkippedFrameCount() const noexcept { return framesSkipped.load (std::memory_order_relaxed); }
+    // frames SpectralGuard had to repair, and how many values in them
+    uint64_t getRepairedFrameCount() const noexcept { return framesRepaired.load (std::memory_order_relaxed); }
+    uint64_t getRepairedValueCount() const noexcept { return valuesRepaired.load (std::memory_order_relaxed); }
+    // Back to empty rings, the state updateParameters () leaves, without allocating (audio thread safe)
+    void clearState() noexcept
+    {
+        for (auto& ring : inputBuffer)
+            std::fill (ring.begin(), ring.end(), 0.0f);
+        for (auto& ring : outputBuffer)
+            std::fill (ring.begin(), ring.end(), 0.0f);
+        inputBufferWritePosition = 0;
+        outputBufferWritePosition = overlap != 0 ? hopSize % outputBufferLength : 0;
+        outputBufferReadPosition = 0;
+        samplesSinceLastFFT = 0;
+
+        for (auto& peaks : hopPeaks)
+            std::fill (peaks.begin(), peaks.end(), 0.0f);
+        std::fill (runningHopPeak.begin(), runningHopPeak.end(), 0.0f);
+        std::fill (silentFrames.begin(), silentFrames.end(), overlap);
+        std::fill (hopCounts.begin(), hopCounts.end(), 0);
+        hopPeakIndex = 0;
+        for (PartialTracker& tracker : partialTrackers)
+            tracker.reset();
+        for (NoiseFilterBank& bank : noiseBanks)
+            bank.reset();
+        for (auto& state : slidingStateRe)
+            std::fill (state.begin(), state.end(), 0.0);
+        for (auto& state : slidingStateIm)
+            std::fill (state.begin(), state.end(), 0.0);
+        std::fill (slidingBins.begin(), slidingBins.end(), 0);
+        std::fill (envelopeSteps.begin(), envelopeSteps.end(), -1);
+    }
+
+    // Bypass: the input goes into the ring and the hops tick as in processBlock (), but no frame is transformed
+    // and nothing is read out. Keeps the ring full so processing can pick up again without waiting for input.
+    // The output ring is left alone, call clearState () first so it resumes from silence
+    void primeInput (const float* const* channelData, const int numBlockChannels, const int numBlockSamples, const int stride = 1)
+    {
+        const int channelsToProcess = numBlockChannels < numChannels ? numBlockChannels : numChannels;
+        for (int channel = 0; channel < channelsToProcess; ++channel) {
+            currentInputBufferWritePosition = inputBufferWritePosition;
+            currentSamplesSinceLastFFT = samplesSinceLastFFT;
+            currentHopPeakIndex = hopPeakIndex;
+            // the sliding DFT starts over from the ring at the next frame
+            if (slidingTerms > 0)
+                slidingBins[channel] = 0;
+            // and the envelope from the next frame's analysis
+            if (envelopeHops > 1)
+                envelopeSteps[channel] = -1;
+
+            for (int sample = 0; sample < numBlockSamples;) {
+                const int runLength = std::min (numBlockSamples - sample, hopSize - currentSamplesSinceLastFFT);
+                writeInput (channel, channelData[channel] + (size_t)sample * stride, runLength, stride);
+                sample += runLength;
+
+                // only so the silence detection has the peaks of the frames that follow
+                if ((currentSamplesSinceLastFFT += runLength) >= hopSize) {
+                    currentSamplesSinceLastFFT = 0;
+                    ++hopCounts[channel];
+                    isSilentFrame (channel);
+                }
+            }
+        }
+
+        // the output ring moves on as if every frame had been skipped
+        const int64_t hops = (samplesSinceLastFFT + (int64_t)numBlockSamples) / hopSize;
+        outputBufferWritePosition = (int)((outputBufferWritePosition + (int)(hops % overlap) * hopSize) % outputBufferLength);
+        outputBufferReadPosition = (int)((outputBufferReadPosition + (int64_t)numBlockSamples) % outputBufferLength);
+        inputBufferWritePosition = currentInputBufferWritePosition;
+        samplesSinceLastFFT = currentSamplesSinceLastFFT;
+        hopPeakIndex = currentHopPeakIndex;
+    }
+
+    // Everything processBlock () carries from one block to the next: the rings and their positions, the
+    // silence detection, the hop counts, the partial trackers, the filter banks, the sliding DFT and the
+    // decimated envelopes (not the parameters or the frame counters). loadState () only takes a state saved
+    // with the same layout (setup (), updateParameters (), sinusoids, filter bank, sliding DFT and envelope
+    // decimation) and never allocates. False if it did not fit
+    void saveState (StateWriter& writer) const
+    {
+        writer.write (fftSize);
+        writer.write (overlap);
+        writer.write (numChannels);
+        for (const auto& ring : inputBuffer)
+            writer.write (ring);
+        for (const auto& ring : outputBuffer)
+            writer.write (ring);
+        writer.write (inputBufferWritePosition);
+        writer.write (outputBufferWritePosition);
+        writer.write (outputBufferReadPosition);
+        writer.write (samplesSinceLastFFT);
+
+        for (const auto& peaks : hopPeaks)
+            writer.write (peaks);
+        writer.write (runningHopPeak);
+        writer.write (silentFrames);
+        writer.write (hopPeakIndex);
+        writer.write (hopCounts);
+
+        writer.write ((int)partialTrackers.size());
+        for (const PartialTracker& tracker : partialTrackers)
+            tracker.saveState (writer);
+        writer.write ((int)noiseBanks.size());
+        for (const NoiseFilterBank& bank : noiseBanks)
+            bank.saveState (writer);
+
+        writer.write (slidingTerms);
+        writer.write (slidingBins);
+        for (const auto& state : slidingStateRe)
+            writer.write (state);
+        for (const auto& state : slidingStateIm)
+            writer.write (state);
+
+        writer.write (envelopeHops);
+        writer.write (envelopeSteps);
+        for (const auto& envelope : envelopeFrom)
+            writer.write (envelope);
+        for (const auto& envelope : envelopeTo)
+            writer.write (envelope);
+        for (const auto& levels : fluxReference)
+            writer.write (levels);
+    }
+
+    bool loadState (StateReader& reader) noexcept
+    {
+        reader.expect (fftSize);
+        reader.expect (overlap);
+        reader.expect (numChannels);
+        for (auto& ring : inputBuffer)
+            reader.read (ring);
+        for (auto& ring : outputBuffer)
+            reader.read (ring);
+        reader.read (inputBufferWritePosition);
+        reader.read (outputBufferWritePosition);
+        reader.read (outputBufferReadPosition);
+        reader.read (samplesSinceLastFFT);
+
+        for (auto& peaks : hopPeaks)
+            reader.read (peaks);
+        reader.read (runningHopPeak);
+        reader.read (silentFrames);
+        reader.read (hopPeakIndex);
+        reader.read (hopCounts);
+
+        reader.expect ((int)partialTrackers.size());
+        for (PartialTracker& tracker : partialTrackers)
+            tracker.loadState (reader);
+        reader.expect ((int)noiseBanks.size());
+        for (NoiseFilterBank& bank : noiseBanks)
+            bank.loadState (reader);
+
+        reader.expect (slidingTerms);
+        reader.read (slidingBins);
+        for (auto& state : slidingStateRe)
+            reader.read (state);
+        for (auto& state : slidingStateIm)
+            reader.read (state);
+
+        reader.expect (envelopeHops);
+        reader.read (envelopeSteps);
+        for (auto& envelope : envelopeFrom)
+            reader.read (envelope);
+        for (auto& envelope : envelopeTo)
+            reader.read (envelope);
+        for (auto& levels : fluxReference)
+            reader.read (levels);
+        return reader.isValid();
+    }
+
+    // clearState () as if `hops` hops had already gone by, for seeking: the hop count is all a frame's
+    // output depends on besides the last two frames of input
+    void setHopCount (const uint64_t hops) noexcept
+    {
+        std::fill (hopCounts.begin(), hopCounts.end(), hops);
+    }
+
+    void resetFrameCounters() noexcept
+    {
+        framesTotal.store (0, std::memory_order_relaxed);
+        framesSkipped.store (0, std::memory_order_relaxed);
+        framesRepaired.store (0, std::memory_order_relaxed);
+        valuesRepaired.store (0, std::memory_order_relaxed);
+    }
+
+    int getFftSize() const noexcept { return fftSize; }
+    int getOverlap() const noexcept { return overlap; }
+
+    // One frame without the rings, for OfflineRenderer: window[0 .. fftSize) is the input it covers
+    // (zeros before the start of the file), frame gets what synthesis () would overlap-add.
+    // Returns false, with frame untouched, if isSilentFrame () would skip it. frameIndex picks
+    // the phasors (updatePhasors ()), so a frame comes out the same whatever order they are rendered in
+    bool renderFrame (const float* window, float* frame, const uint64_t frameIndex = 0)
+    {
+        if (! loadFrame (window))
+            return false;
+
+        if (phasorPhases)
+            phasorStart = phasorOffset (frameIndex);
+        modification();
+        writeFrame (frame);
+        countRepairs();
+        return true;
+    }
+
+    // Time stretching, see OfflineRenderer::renderStretched (): the stochastic magnitude envelope
+    // (stochEnv, in dB) of one window into envelope[0 .. fftSize / 2 + 1). False if the frame is silent
+    bool analyseEnvelope (const float* window, float* envelope)
+    {
+        if (! loadFrame (window))
+            return false;
+
+        fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+        analyseSpectrum();
+        const int numBins = fftSize / 2 + 1;
+        std::copy (stochEnv.begin(), stochEnv.begin() + lastAnalysedBins, envelope);
+        std::fill (envelope + lastAnalysedBins, envelope + numBins, 0.0f);
+        countRepairs();
+        return true;
+    }
+
+    // A frame like renderFrame () from an envelope, with new random phases in place of the analysed
+    // ones. The phases only depend on seed, so any thread rendering the same frame gets the same one
+    void synthesiseEnvelope (const float* envelope, const uint64_t seed, float* frame)
+    {
+        const int numBins = fftSize / 2 + 1;
+        std::copy (envelope, envelope + numBins, stochEnv.begin());
+        drawPhases (seed);
+        resynthesise (false);
+        writeFrame (frame);
+        countRepairs();
+    }
+
+
+private:
+    //======================================
+
+    void updateFftSize (const int newFftSize)
+    {
+        fftSize = newFftSize;
+
+        inputBufferLength = fftSize;
+        inputBuffer.assign (numChannels, std::vector<float> (inputBufferLength, 0.0f));
+
+        outputBufferLength = fftSize;
+        outputBuffer.assign (numChannels, std::vector<float> (outputBufferLength, 0.0f));
+
+        timeDomainBuffer.reset(new std::complex<float>[fftSize]);
+        frequencyDomainBuffer.reset(new std::complex<float>[fftSize]);
+        timeoutbufferBuffer.reset(new std::complex<float>[fftSize]);
+        realInverseScratch.reset(new std::complex<float>[fftSize / 2]);
+        phasorAmplitude.assign (fftSize / 2 + 1, 0.0f);
+        for (auto* bins : { &stochEnv, &stochphaseEnv, &mX, &filterKernel, &pruningTaper, &filteredphase, &cubicfilteredPhase })
+            bins->assign (fftSize / 2 + 1, 0.0f);
+        // the real parts of the complex inverse, or all of it after performRealInverse ()
+        synthesisFrame = reinterpret_cast<float*> (timeoutbufferBuffer.get());
+        synthesisFrameStride = 2;
+        filterKernelDirty = true;
+        
+        inputBufferWritePosition = 0;
+        outputBufferWritePosition = 0;
+        outputBufferReadPosition = 0;
+        samplesSinceLastFFT = 0;
+    }
+
+    void updateHopSize (const int newOverlap)
+    {
+        overlap = newOverlap;
+        if (overlap != 0) {
+            hopSize = fftSize / overlap;
+            outputBufferWritePosition = hopSize % outputBufferLength;
+        }
+
+        // the rings start out empty, which counts as a full frame of silence
+        hopPeaks.assign (numChannels, std::vector<float> (overlap > 0 ? overlap : 1, 0.0f));
+        runningHopPeak.assign (numChannels, 0.0f);
+        silentFrames.assign (numChannels, overlap);
+        hopCounts.assign (numChannels, 0);
+        hopPeakIndex = 0;
+    }
+
+    void updateWindow (const int newWindowType)
+    {
+        windowType = newWindowType;
+        acquireTables();
+
+        const float windowSum = tables->windowSum;
+        windowScaleFactor = 0.0f;
+        if (overlap != 0 && windowSum != 0.0f)
+            windowScaleFactor = 1.0f / (float)overlap / windowSum * (float)fftSize;
+    }
+
+    // enough columns for every frame of the biggest block, capped so the batch stays in cache
+    // (big frames gain nothing from it, they already fill the cache on their own)
+    void allocateBatch()
+    {
+        const int maxFrames = hopSize > 0 ? maxBlockSize / hopSize + 1 : 0;
+        const int framesPerBatch = fftSize > 0 ? std::min ({ maxFrames, maxBatchFrames, maxBatchSamples / fftSize }) : 0;
+
+        if (channelLanes && fftSize > 0) {
+            // a column per channel even when only one frame fits, in whole SSE vectors
+            const int columns = std::max (1, framesPerBatch) * numChannels;
+            batchCapacity = (columns + laneWidth - 1) / laneWidth * laneWidth;
+        } else {
+            batchCapacity = frameBatching && framesPerBatch >= minBatchFrames ? framesPerBatch : 0;
+        }
+        // the partials are tracked hop by hop, in frame order, the filter bank has no frames to batch,
+        // the sliding DFT moves one sample at a time, the spectral nodes take one frame at a time, and
+        // a decimated envelope ramps from one hop to the next
+        if (sinusoidMaxPartials > 0 || filterBankBands > 0 || slidingTerms > 0 || ! spectralNodes.empty() || envelopeInterval > 1)
+            batchCapacity = 0;
+
+        const size_t numBins = (size_t)(fftSize / 2 + 1);
+        batchReal.assign ((size_t)fftSize * batchCapacity, 0.0f);
+        batchImag.assign ((size_t)fftSize * batchCapacity, 0.0f);
+        batchScratchReal.assign ((size_t)fftSize / 2 * batchCapacity, 0.0f);
+        batchScratchImag.assign ((size_t)fftSize / 2 * batchCapacity, 0.0f);
+        batchMagnitude.assign (numBins * batchCapacity, 0.0f);
+        batchEnvelope.assign (numBins * batchCapacity, 0.0f);
+        batchFilteredPhase.assign (numBins * batchCapacity, 0.0f);
+        batchCubicPhase.assign (numBins * batchCapacity, 0.0f);
+        batchBoundaries.assign (batchCapacity, 0);
+        batchColumns.assign (batchCapacity, 0);
+        batchPhasorStarts.assign (batchCapacity, 0);
+        batchRepairs.assign (batchCapacity, 0);
+    }
+
+    // a tracker per channel, its oscillators ramp over one hop
+    void allocateSinusoids()
+    {
+        sinusoidPartials = fftSize > 0 && overlap >= 2 && filterBankBands == 0 ? sinusoidMaxPartials : 0;
+        const int numBins = fftSize / 2 + 1;
+        partialTrackers.assign (sinusoidPartials > 0 ? numChannels : 0, PartialTracker());
+        for (PartialTracker& tracker : partialTrackers)
+            tracker.prepare (sinusoidPartials, hopSize);
+
+        framePeaks.assign (sinusoidPartials > 0 ? (size_t)sinusoidPartials : 0, PartialTracker::Peak());
+        peakScratch.assign (sinusoidPartials > 0 ? (size_t)numBins / 2 + 1 : 0, PartialTracker::Peak());
+        partialFrequencies.assign (framePeaks.size(), 0.0f);
+        partialAmplitudes.assign (framePeaks.size(), 0.0f);
+        residualX.assign (sinusoidPartials > 0 ? (size_t)numBins : 0, 0.0f);
+        partialHop.assign (sinusoidPartials > 0 ? (size_t)hopSize : 0, 0.0f);
+        numFramePeaks = 0;
+    }
+
+    // A bank per channel, and for every band the bins it covers: bin k spans k +- 0.5 bins, so the
+    // first and last ones of a band only count with the part of them inside it
+    void allocateFilterBank()
+    {
+        const int numBins = fftSize / 2 + 1;
+        const int numBands = fftSize > 0 ? filterBankBands : 0;
+        noiseBanks.assign (numBands > 0 ? numChannels : 0, NoiseFilterBank());
+        for (NoiseFilterBank& bank : noiseBanks)
+            bank.prepare (sampleRate, numBands);
+
+        bandFirstBin.assign ((size_t)numBands, 0);
+        bandLastBin.assign ((size_t)numBands, 0);
+        bandFirstWeight.assign ((size_t)numBands, 0.0f);
+        bandLastWeight.assign ((size_t)numBands, 0.0f);
+        bandGains.assign ((size_t)numBands, 0.0f);
+        silentBands.assign ((size_t)numBands, 0.0f);
+        binPower.assign (numBands > 0 ? (size_t)numBins : 0, 0.0f);
+        if (numBands == 0)
+            return;
+
+        const double binWidth = sampleRate / fftSize;
+        for (int band = 0; band < numBands; ++band) {
+            const double lower = std::min ((double)numBins, noiseBanks.front().getBandEdge (band) / binWidth + 0.5);
+            const double upper = std::min ((double)numBins, noiseBanks.front().getBandEdge (band + 1) / binWidth + 0.5);
+            const int first = std::min (numBins - 1, (int)lower);
+            const int last = std::max (first, std::min (numBins - 1, (int)std::ceil (upper) - 1));
+            bandFirstBin[(size_t)band] = first;
+            bandLastBin[(size_t)band] = last;
+            bandFirstWeight[(size_t)band] = (float)std::max (0.0, std::min (upper, first + 1.0) - lower);
+            bandLastWeight[(size_t)band] = last > first ? (float)(upper - last) : 0.0f;
+        }
+        // random phases overlap-added: frame power / overlap, through the same scaling as synthesis (), both halves
+        bandScale = tables->windowSum > 0.0f && overlap > 0 ? std::sqrt (2.0f / (float)overlap) / tables->windowSum : 0.0f;
+    }
+
+    // The sliding DFT's resonators, see updateSlidingDft (). A window a - b cos (theta m) with theta =
+    // 2 pi / (fftSize - 1) is a times the spectrum minus b / 2 times the spectra theta either side of each
+    // bin, so term 0 of every bin sits on the bin, 1 and 2 theta below and above it (only 0 without a cosine)
+    void allocateSliding()
+    {
+        const int numBins = fftSize / 2 + 1;
+        slidingTerms = 0;
+        if (slidingDft && fftSize > 0) {
+            const bool raisedCosine = windowType == windowTypeHann || windowType == windowTypeHamming;
+            if (raisedCosine || windowType == windowTypeRectangular)
+                slidingTerms = raisedCosine ? 3 : 1;
+            slidingCentre = windowType == windowTypeHamming ? 0.54 : windowType == windowTypeHann ? 0.5 : 1.0;
+            slidingSide = windowType == windowTypeHamming ? 0.23 : windowType == windowTypeHann ? 0.25 : 0.0;
+        }
+
+        const size_t size = (size_t)(slidingTerms * numBins);
+        slidingRotationRe.assign (size, 0.0);
+        slidingRotationIm.assign (size, 0.0);
+        slidingStateRe.assign (slidingTerms > 0 ? numChannels : 0, std::vector<double> (size, 0.0));
+        slidingStateIm.assign (slidingTerms > 0 ? numChannels : 0, std::vector<double> (size, 0.0));
+        slidingBins.assign (slidingTerms > 0 ? numChannels : 0, 0);
+        slidingModulation.assign (slidingTerms > 1 ? (size_t)fftSize : 0, std::complex<float>());
+        if (slidingTerms == 0)
+            return;
+
+        const double theta = 2.0 * M_PI / (fftSize - 1);
+        const double shifts[] { 0.0, -theta, theta };
+        for (int term = 0; term < slidingTerms; ++term) {
+            for (int bin = 0; bin < numBins; ++bin) {
+                const double omega = 2.0 * M_PI * bin / fftSize + shifts[term];
+                slidingRotationRe[(size_t)(term * numBins + bin)] = std::cos (omega);
+                slidingRotationIm[(size_t)(term * numBins + bin)] = std::sin (omega);
+            }
+        }
+        // e^(i theta m), the spectrum of the frame times it is the one theta below every bin
+        for (int index = 0; index < (int)slidingModulation.size(); ++index)
+            slidingModulation[(size_t)index] = std::polar (1.0f, (float)(theta * index));
+    }
+
+    // per channel the envelopes the ramp goes between and the flux reference, see updateEnvelopeDecimation ()
+    void allocateEnvelopeDecimation()
+    {
+        const int numBins = fftSize / 2 + 1;
+        envelopeHops = fftSize > 0 && sinusoidPartials == 0 && filterBankBands == 0 && slidingTerms == 0 ? envelopeInterval : 1;
+        const size_t channels = envelopeHops > 1 ? (size_t)numChannels : 0;
+        envelopeFrom.assign (channels, std::vector<float> ((size_t)numBins, 0.0f));
+        envelopeTo.assign (channels, std::vector<float> ((size_t)numBins, 0.0f));
+        envelopeSteps.assign (channels, -1);
+
+        const bool flux = envelopeHops > 1 && envelopeFluxThreshold > 0.0f;
+        fluxSize = std::max (minFluxSize, fftSize / fluxDecimation);
+        fluxTables = flux ? STFTTables::acquire (fluxSize, windowTypeHann, sampleRate) : nullptr;
+        fluxReference.assign (flux ? channels : 0, std::vector<float> (fluxBands, 0.0f));
+        fluxLevels.assign (flux ? fluxBands : 0, 0.0f);
+    }
+
+    void prepareSpectralNodes()
+    {
+        if (tables == nullptr)
+            return;
+        for (auto& node : spectralNodes)
+            node->prepare (sampleRate, fftSize, tables->windowSum);
+    }
+
+    // FFT plan, window and the other per-size tables are shared with every STFT using the same ones
+    void acquireTables()
+    {
+        tables = STFTTables::acquire (fftSize, windowType, sampleRate);
+        fft = &tables->fft;
+        fftWindow = tables->window.data();
+        randomBins = tables->randomBins.data();
+        telemetryBins = tables->telemetryBins.data();
+    }
+
+    // the windowed frame into timeDomainBuffer, false if it is silent (nothing is loaded then)
+    bool loadFrame (const float* window)
+    {
+        float peak = 0.0f;
+        for (int index = 0; index < fftSize; ++index)
+            peak = std::fabs (window[index]) > peak ? std::fabs (window[index]) : peak;
+        if (peak <= silenceThreshold)
+            return false;
+
+        kernels->window (fftWindow, window, timeDomainBuffer.get(), fftSize);
+        return true;
+    }
+
+    // synthesisFrame scaled like synthesis () adds it to the output ring
+    void writeFrame (float* frame) const
+    {
+        for (int index = 0; index < fftSize; ++index)
+            frame[index] = synthesisFrame[(size_t)index * synthesisFrameStride] * windowScaleFactor;
+    }
+
+    //======================================
+
+    // trackPeak = false when the hop peaks were already taken (processBatch ())
+    void writeInput (const int channel, const float* source, const int length, const int stride, const bool trackPeak = true)
+    {
+        float* ring = inputBuffer[channel].data();
+        float peak = runningHopPeak[channel];
+
+        for (int done = 0; done < length;) {
+            const int span = std::min (length - done, inputBufferLength - currentInputBufferWritePosition);
+            float* destination = ring + currentInputBufferWritePosition;
+            const float* input = source + (size_t)done * stride;
+
+            if (trackPeak) {
+                for (int i = 0; i < span; ++i) {
+                    const float inputSample = input[(size_t)i * stride];
+                    destination[i] = inputSample;
+                    const float magnitude = std::fabs (inputSample);
+                    peak = magnitude > peak ? magnitude : peak;
+                }
+            } else {
+                for (int i = 0; i < span; ++i)
+                    destination[i] = input[(size_t)i * stride];
+            }
+
+            done += span;
+            if ((currentInputBufferWritePosition += span) >= inputBufferLength)
+                currentInputBufferWritePosition = 0;
+        }
+
+        runningHopPeak[channel] = peak;
+    }
+
+    void readOutput (const int channel, float* destination, const int length, const int stride)
+    {
+        float* ring = outputBuffer[channel].data();
+        // every frame still overlapping the read position was skipped, so the ring only holds zeros
+        const bool decayed = silentFrames[channel] >= overlap;
+
+        for (int done = 0; done < length;) {
+            const int span = std::min (length - done, outputBufferLength - currentOutputBufferReadPosition);
+            float* source = ring + currentOutputBufferReadPosition;
+            float* output = destination + (size_t)done * stride;
+
+            if (decayed) {
+                for (int i = 0; i < span; ++i)
+                    output[(size_t)i * stride] = 0.0f;
+            } else {
+                for (int i = 0; i < span; ++i)
+                    output[(size_t)i * stride] = source[i];
+                std::fill (source, source + span, 0.0f);
+            }
+
+            done += span;
+            if ((currentOutputBufferReadPosition += span) >= outputBufferLength)
+                currentOutputBufferReadPosition = 0;
+        }
+    }
+
+    // Every frame ending between start and the end of the block only needs input that is already there,
+    // so they are all analysed, transformed and resynthesised first, and the block is then walked hop
+    // by hop exactly like the frame by frame path, overlap-adding them in order. With channel lanes
+    // channelData holds numBatchChannels channels from firstChannel on, and they share the batch.
+    // Returns the new position.
+    int processBatch (float* const* channelData, const int firstChannel, const int numBatchChannels, const int start, const int stride)
+    {
+        const int framesDue = std::min (batchCapacity / numBatchChannels, (numSamples - start + currentSamplesSinceLastFFT) / hopSize);
+        const int firstEnd = start + hopSize - currentSamplesSinceLastFFT;
+        for (int frame = 0; frame < framesDue; ++frame)
+            batchBoundaries[frame] = firstEnd + frame * hopSize;
+
+        // every channel starts from the same ring positions
+        const int inputWritePosition = currentInputBufferWritePosition;
+        const int outputWritePosition = currentOutputBufferWritePosition;
+        const int outputReadPosition = currentOutputBufferReadPosition;
+        const int samplesSinceFFT = currentSamplesSinceLastFFT;
+        const int peakIndex = currentHopPeakIndex;
+        auto rewind = [&] {
+            currentInputBufferWritePosition = inputWritePosition;
+            currentOutputBufferWritePosition = outputWritePosition;
+            currentOutputBufferReadPosition = outputReadPosition;
+            currentSamplesSinceLastFFT = samplesSinceFFT;
+            currentHopPeakIndex = peakIndex;
+        };
+
+        // hop peaks first, silent frames get no column
+        int numColumns = 0;
+        int nextPeakIndex = peakIndex;
+        for (int lane = 0; lane < numBatchChannels; ++lane) {
+            rewind();
+            const int channel = firstChannel + lane;
+            const float* data = channelData[lane];
+
+            for (int frame = 0; frame < framesDue; ++frame) {
+                const int end = batchBoundaries[frame];
+                float peak = runningHopPeak[channel];
+                for (int sample = std::max (start, end - hopSize); sample < end; ++sample) {
+                    const float magnitude = std::fabs (data[(size_t)sample * stride]);
+                    peak = magnitude > peak ? magnitude : peak;
+                }
+                runningHopPeak[channel] = peak;
+                const uint64_t hop = hopCounts[channel]++;
+                const int column = isSilentFrame (channel) ? -1 : numColumns++;
+                batchColumns[lane * framesDue + frame] = column;
+                if (column >= 0 && phasorPhases)
+                    batchPhasorStarts[column] = phasorOffset (((uint64_t)channel << 48) + hop);
+            }
+            nextPeakIndex = currentHopPeakIndex;
+        }
+
+        // lanes run in whole vectors, the padding columns are zero
+        const int batchColumnCount = channelLanes ? (numColumns + laneWidth - 1) / laneWidth * laneWidth : numColumns;
+        rewind();
+        for (int lane = 0; lane < numBatchChannels; ++lane) {
+            for (int frame = 0; frame < framesDue; ++frame) {
+                const int column = batchColumns[lane * framesDue + frame];
+                if (column >= 0)
+                    analysisBatch (firstChannel + lane, channelData[lane], start, stride, batchBoundaries[frame] - fftSize, column, batchColumnCount);
+            }
+        }
+        for (int column = numColumns; column < batchColumnCount; ++column) {
+            batchPhasorStarts[column] = 0;
+            for (int index = 0; index < fftSize; ++index) {
+                batchReal[(size_t)index * batchColumnCount + column] = 0.0f;
+                batchImag[(size_t)index * batchColumnCount + column] = 0.0f;
+            }
+        }
+
+        if (numColumns > 0)
+            modificationBatch (batchColumnCount);
+
+        const int end = framesDue > 0 ? batchBoundaries[framesDue - 1] : numSamples;
+        for (int lane = 0; lane < numBatchChannels; ++lane) {
+            rewind();
+            const int channel = firstChannel + lane;
+            float* data = channelData[lane];
+
+            int sample = start;
+            for (int frame = 0; frame < framesDue; ++frame) {
+                const int runLength = batchBoundaries[frame] - sample;
+                float* run = data + (size_t)sample * stride;
+
+                writeInput (channel, run, runLength, stride, false);
+                readOutput (channel, run, runLength, stride);
+                sample += runLength;
+                currentSamplesSinceLastFFT = 0;
+
+                const int column = batchColumns[lane * framesDue + frame];
+                if (column < 0) {
+                    skipFrame (channel);
+                } else {
+                    silentFrames[channel] = 0;
+                    synthesis (channel, batchReal.data() + column, batchColumnCount);
+                    frameRepairs += batchRepairs[column];
+                }
+                countRepairs();
+
+                // one snapshot per batch is plenty for a display
+                if (telemetryEnabled && channel == 0 && frame == framesDue - 1) {
+                    if (column >= 0) {
+                        for (int bin = 0; bin < lastAnalysedBins; ++bin) {
+                            mX[bin] = batchMagnitude[(size_t)bin * batchColumnCount + column];
+                            stochEnv[bin] = batchEnvelope[(size_t)bin * batchColumnCount + column];
+                        }
+                    }
+                    publishSpectrum (column < 0);
+                }
+                increment (framesTotal);
+            }
+
+            // no hop boundary left in the block, only the channels batched with it get here
+            if (framesDue == 0) {
+                float* run = data + (size_t)start * stride;
+                writeInput (channel, run, end - start, stride);
+                readOutput (channel, run, end - start, stride);
+                currentSamplesSinceLastFFT += end - start;
+            }
+            currentHopPeakIndex = nextPeakIndex;
+        }
+
+        return end;
+    }
+
+    // a frame is exactly the last `overlap` hops, so its peak is the max of their peaks
+    bool isSilentFrame (const int channel)
+    {
+        std::vector<float>& peaks = hopPeaks[channel];
+        peaks[currentHopPeakIndex] = runningHopPeak[channel];
+        runningHopPeak[channel] = 0.0f;
+        if (++currentHopPeakIndex >= overlap)
+            currentHopPeakIndex = 0;
+
+        float framePeak = 0.0f;
+        for (const float peak : peaks)
+            framePeak = peak > framePeak ? peak : framePeak;
+
+        return framePeak <= silenceThreshold;
+    }
+
+    // nothing gets added to the output ring, it just moves on by one hop like synthesis () does.
+    // The sliding DFT stops until the next frame that is not silent, which starts it over from the ring,
+    // and a decimated envelope starts over from that frame's analysis
+    void skipFrame (const int channel)
+    {
+        if (slidingTerms > 0)
+            slidingBins[channel] = 0;
+        if (envelopeHops > 1)
+            envelopeSteps[channel] = -1;
+        if (silentFrames[channel] < overlap)
+            ++silentFrames[channel];
+
+        currentOutputBufferWritePosition += hopSize;
+        if (currentOutputBufferWritePosition >= outputBufferLength)
+            currentOutputBufferWritePosition = 0;
+
+        increment (framesSkipped);
+    }
+
+    // each point is the max over its bins, so narrow peaks survive the decimation
+    void publishSpectrum (const bool silent)
+    {
+        SpectrumSnapshot& snapshot = spectrumTap->getWriteBuffer();
+        snapshot.sampleRate = sampleRate;
+        snapshot.fftSize = fftSize;
+        snapshot.silent = silent;
+        snapshot.frame = framesTotal.load (std::memory_order_relaxed);
+
+        const int validBins = silent ? 0 : lastAnalysedBins;
+        const float floorDb = -200.0f;
+
+        for (int point = 0; point < SpectrumSnapshot::numPoints; ++point) {
+            const int begin = std::min (telemetryBins[point], fftSize / 2);
+            const int end = std::max (telemetryBins[point + 1], begin + 1);
+            float magnitude = floorDb, envelope = floorDb, kernel = 0.0f;
+
+            for (int bin = begin; bin < end; ++bin) {
+                if (bin < validBins) {
+                    magnitude = mX[bin] > magnitude ? mX[bin] : magnitude;
+                    envelope = stochEnv[bin] > envelope ? stochEnv[bin] : envelope;
+                }
+                kernel = filterKernel[bin] > kernel ? filterKernel[bin] : kernel;
+            }
+
+            snapshot.magnitude[point] = magnitude;
+            snapshot.envelope[point] = envelope;
+            snapshot.kernel[point] = kernel;
+        }
+
+        spectrumTap->publish();
+    }
+
+    static void increment (std::atomic<uint64_t>& counter, const uint64_t amount = 1) noexcept
+    {
+        // single writer, so no read-modify-write needed
+        counter.store (counter.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // what SpectralGuard repaired in the frame just done into the counters
+    void countRepairs() noexcept
+    {
+        if (frameRepairs > 0) {
+            increment (framesRepaired);
+            increment (valuesRepaired, (uint64_t)frameRepairs);
+        }
+        frameRepairs = 0;
+    }
+
+    // The resonators one run of new samples on, before writeInput () overwrites the oldest ones. For a
+    // frequency w the DFT of the last fftSize samples (oldest first) moves on as S = e^(iw) (S - oldest)
+    // + newest e^(-iw (fftSize - 1)), and that last factor is the bin's own e^(iw) for all three terms
+    void slide (const int channel, const float* source, const int length, const int stride)
+    {
+        const int bins = slidingBins[channel];
+        if (bins == 0)
+            return;
+
+        const int numBins = fftSize / 2 + 1;
+        const float* ring = inputBuffer[channel].data();
+        int position = currentInputBufferWritePosition;
+        for (int done = 0; done < length;) {
+            const int span = std::min (length - done, inputBufferLength - position);
+            for (int term = 0; term < slidingTerms; ++term) {
+                const size_t offset = (size_t)(term * numBins);
+                kernels->slide (source + (size_t)done * stride, stride, ring + position, span,
+                                slidingRotationRe.data() + offset, slidingRotationIm.data() + offset,
+                                slidingRotationRe.data(), slidingRotationIm.data(),
+                                slidingStateRe[channel].data() + offset, slidingStateIm[channel].data() + offset, bins);
+            }
+            done += span;
+            if ((position += span) >= inputBufferLength)
+                position = 0;
+        }
+    }
+
+    // The windowed spectrum of the frame just completed into frequencyDomainBuffer, what analysis () and
+    // the FFT give. The resonators start over from the ring (two FFTs, one without the cosine terms) once
+    // a frame, whenever they were stopped, and when the bins analysed change
+    void slidingSpectrum (const int channel, const uint64_t hop)
+    {
+        if (filterKernelDirty)
+            updateFilterKernel();
+
+        const int numBins = fftSize / 2 + 1;
+        const int bins = std::min (numBins, (binPruning ? prunedBins : numBins) + 3);
+        double* stateRe = slidingStateRe[channel].data();
+        double* stateIm = slidingStateIm[channel].data();
+
+        if (bins != slidingBins[channel] || hop % (uint64_t)overlap == 0) {
+            const float* ring = inputBuffer[channel].data();
+            for (int index = 0; index < fftSize; ++index)
+                timeDomainBuffer[index] = ring[(currentInputBufferWritePosition + index) % inputBufferLength];
+            fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+            for (int bin = 0; bin < bins; ++bin) {
+                stateRe[bin] = frequencyDomainBuffer[bin].real();
+                stateIm[bin] = frequencyDomainBuffer[bin].imag();
+            }
+
+            if (slidingTerms > 1) {
+                // theta above bin k is the conjugate of theta below bin fftSize - k, the frame is real
+                for (int index = 0; index < fftSize; ++index)
+                    timeDomainBuffer[index] *= slidingModulation[(size_t)index];
+                fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+                for (int bin = 0; bin < bins; ++bin) {
+                    const std::complex<float> mirrored = frequencyDomainBuffer[(fftSize - bin) % fftSize];
+                    stateRe[numBins + bin] = frequencyDomainBuffer[bin].real();
+                    stateIm[numBins + bin] = frequencyDomainBuffer[bin].imag();
+                    stateRe[2 * numBins + bin] = mirrored.real();
+                    stateIm[2 * numBins + bin] = -mirrored.imag();
+                }
+            }
+            slidingBins[channel] = bins;
+        }
+
+        for (int bin = 0; bin < bins; ++bin) {
+            double re = slidingCentre * stateRe[bin];
+            double im = slidingCentre * stateIm[bin];
+            if (slidingTerms > 1) {
+                re -= slidingSide * (stateRe[numBins + bin] + stateRe[2 * numBins + bin]);
+                im -= slidingSide * (stateIm[numBins + bin] + stateIm[2 * numBins + bin]);
+            }
+            frequencyDomainBuffer[bin] = { (float)re, (float)im };
+        }
+    }
+
+    // modification () with the envelope analysed every envelopeHops hops, or straight away when the flux
+    // says so, and ramped in between (see updateEnvelopeDecimation ()). A channel with nothing analysed
+    // since it started or last went silent starts with an analysis
+    void decimatedModification (const int channel, const uint64_t hop)
+    {
+        const int numBins = fftSize / 2 + 1;
+        float* from = envelopeFrom[channel].data();
+        float* to = envelopeTo[channel].data();
+        int& step = envelopeSteps[channel];
+
+        const bool scheduled = hop % (uint64_t)envelopeHops == 0 && step >= 0;
+        bool jump = step < 0;
+        if (! scheduled && ! jump && fluxTables != nullptr) {
+            measureBands (channel, fluxLevels.data());
+            jump = measureFlux (channel) > envelopeFluxThreshold;
+        }
+
+        if (scheduled || jump) {
+            if (fluxTables != nullptr) {
+                if (scheduled || step < 0)
+                    measureBands (channel, fluxLevels.data());
+                std::copy (fluxLevels.begin(), fluxLevels.end(), fluxReference[channel].begin());
+            }
+            analysis (channel);
+            fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+            analyseSpectrum();
+
+            // the ramp starts from what the last hop played, a jump goes straight to the new envelope
+            if (scheduled && step < envelopeHops) {
+                const float weight = (float)step / (float)envelopeHops;
+                for (int bin = 0; bin < numBins; ++bin)
+                    from[bin] = from[bin] + (to[bin] - from[bin]) * weight;
+            } else if (scheduled)
+                std::copy (to, to + numBins, from);
+            else
+                std::copy (stochEnv.begin(), stochEnv.begin() + numBins, from);
+            std::copy (stochEnv.begin(), stochEnv.begin() + numBins, to);
+            step = scheduled ? 0 : envelopeHops;
+        }
+
+        if (step + 1 >= envelopeHops) {
+            std::copy (to, to + numBins, stochEnv.begin());
+        } else {
+            const float weight = (float)(step + 1) / (float)envelopeHops;
+            for (int bin = 0; bin < numBins; ++bin)
+                stochEnv[bin] = from[bin] + (to[bin] - from[bin]) * weight;
+        }
+        step = std::min (step + 1, envelopeHops);
+
+        drawPhases (((uint64_t)channel << 48) + hop);
+        resynthesise (false);
+    }
+
+    // band magnitudes (the root of their power) of a Hann windowed frame of the newest fluxSize samples,
+    // fluxBands bands of the same width from the first bin up
+    void measureBands (const int channel, float* levels)
+    {
+        const float* ring = inputBuffer[channel].data();
+        const float* window = fluxTables->window.data();
+        int inputBufferIndex = (currentInputBufferWritePosition + inputBufferLength - fluxSize) % inputBufferLength;
+        for (int index = 0; index < fluxSize; ++index) {
+            timeDomainBuffer[index] = { window[index] * ring[inputBufferIndex], 0.0f };
+            if (++inputBufferIndex >= inputBufferLength)
+                inputBufferIndex = 0;
+        }
+        fluxTables->fft.perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+
+        const int binsPerBand = std::max (1, fluxSize / 2 / fluxBands);
+        for (int band = 0; band < fluxBands; ++band) {
+            float power = 0.0f;
+            for (int bin = 1 + band * binsPerBand; bin < 1 + (band + 1) * binsPerBand; ++bin)
+                power += std::norm (frequencyDomainBuffer[bin]);
+            levels[band] = std::sqrt (power);
+        }
+    }
+
+    // how far fluxLevels moved from the levels at the last analysis, relative to those. NaN from bad
+    // input compares false and leaves it to the next scheduled analysis
+    float measureFlux (const int channel) const
+    {
+        const float* reference = fluxReference[channel].data();
+        float change = 0.0f, total = 0.0f;
+        for (int band = 0; band < fluxBands; ++band) {
+            change += std::fabs (fluxLevels[(size_t)band] - reference[band]);
+            total += reference[band];
+        }
+        return change / (total + 1.0e-20f);
+    }
+
+    void analysis (const int channel)
+    {
+        // the ring holds exactly one frame, the oldest sample is where the next one gets written
+        const float* ring = inputBuffer[channel].data();
+        const int firstSpan = inputBufferLength - currentInputBufferWritePosition;
+        kernels->window (fftWindow, ring + currentInputBufferWritePosition, timeDomainBuffer.get(), firstSpan);
+        kernels->window (fftWindow + firstSpan, ring, timeDomainBuffer.get() + firstSpan, fftSize - firstSpan);
+    }
+   
+    // analysis () into column `column` of the batch planes, for the frame whose first sample is at
+    // block position `first`. Whatever comes before `start` is still in the input ring.
+    void analysisBatch (const int channel, const float* data, const int start, const int stride,
+                        const int first, const int column, const int numColumns)
+    {
+        const float* ring = inputBuffer[channel].data();
+        const int fromRing = std::min (fftSize, std::max (0, start - first));
+        float* real = batchReal.data() + column;
+        float* imag = batchImag.data() + column;
+
+        int inputBufferIndex = (currentInputBufferWritePosition + inputBufferLength - fromRing) % inputBufferLength;
+        for (int index = 0; index < fromRing; ++index) {
+            real[(size_t)index * numColumns] = fftWindow[index] * ring[inputBufferIndex];
+            imag[(size_t)index * numColumns] = 0.0f;
+
+            if (++inputBufferIndex >= inputBufferLength)
+                inputBufferIndex = 0;
+        }
+
+        for (int index = fromRing; index < fftSize; ++index) {
+            real[(size_t)index * numColumns] = fftWindow[index] * data[(size_t)(first + index) * stride];
+            imag[(size_t)index * numColumns] = 0.0f;
+        }
+    }
+
+    virtual void modification()
+    {
+        fft->perform(timeDomainBuffer.get(), frequencyDomainBuffer.get(), false);
+        analyseSpectrum();
+        resynthesise();
+    }
+
+    // magnitudes and stochastic envelopes of frequencyDomainBuffer
+    void analyseSpectrum()
+    {
+        if (filterKernelDirty)
+            updateFilterKernel();
+
+        const int numBins = fftSize / 2 + 1;
+        // with bin pruning only the band up to the cutoff (plus the taper) gets resynthesised,
+        // the cubic interpolation below looks up to three bins ahead of that
+        const int activeBins = binPruning ? prunedBins : numBins;
+        const int analysedBins = std::min (numBins, activeBins + 3);
+        lastAnalysedBins = analysedBins;
+        
+        // NaN / Inf from the input and denormals out first, then a floor under log10 (0)
+        frameRepairs += SpectralGuard::scrub (reinterpret_cast<float*> (frequencyDomainBuffer.get()), 2 * analysedBins);
+        //calculate magntiude spectrum
+        const float* bins = reinterpret_cast<const float*> (frequencyDomainBuffer.get());
+        kernels->magnitudeDbExact (bins, bins + 1, 2, mX.data(), analysedBins);
+        frameRepairs += SpectralGuard::clampDb (mX.data(), analysedBins);
+        // with sinusoids on, the envelope only gets what the partials leave
+        const float* magnitudes = sinusoidPartials > 0 ? removePeaks (analysedBins) : mX.data();
+        // apply stochastic function
+            float stocf = fftSize / 2 + 1 * stocfactor;
+            float decifac = stocfactor * 100;
+                for (int j = 0; j < stocf && j < analysedBins; j++) {
+                    stochEnv[j] = fmod(magnitudes[j],decifac);
+                    // the phasors do without, that is the atan2 they save
+                    if (! phasorPhases)
+                        stochphaseEnv[j] = fmod(arg(frequencyDomainBuffer[j]),decifac);
+            }
+    }
+
+    // analyseSpectrum () and the amplitudes resynthesise () makes of it, without any phase: the power of
+    // every bin of frequencyDomainBuffer summed into the filter bank's bands, as the RMS of each band into bandGains
+    void analyseBands()
+    {
+        if (filterKernelDirty)
+            updateFilterKernel();
+
+        const int numBins = fftSize / 2 + 1;
+        const int activeBins = binPruning ? prunedBins : numBins;
+        lastAnalysedBins = activeBins;
+
+        const float decifac = stocfactor * 100;
+        const float noiseLevel = decimation * 0.1f;
+        frameRepairs += SpectralGuard::scrub (reinterpret_cast<float*> (frequencyDomainBuffer.get()), 2 * activeBins);
+        const float* bins = reinterpret_cast<const float*> (frequencyDomainBuffer.get());
+        kernels->magnitudeDbExact (bins, bins + 1, 2, mX.data(), activeBins);
+        frameRepairs += SpectralGuard::clampDb (mX.data(), activeBins);
+        for (int index = 0; index < activeBins; ++index) {
+            stochEnv[index] = fmod(mX[index], decifac);
+
+            float resAmp = std::exp(stochEnv[index] / 20.0f);
+            if (index < filterKernelBins)
+                resAmp += randomBins[index] * noiseLevel * filterKernel[index];
+            if (binPruning && index >= taperStartBin)
+                resAmp *= pruningTaper[index - taperStartBin];
+            binPower[(size_t)index] = resAmp * resAmp;
+        }
+        std::fill (binPower.begin() + activeBins, binPower.end(), 0.0f);
+
+        for (size_t band = 0; band < bandGains.size(); ++band) {
+            const int first = bandFirstBin[band], last = bandLastBin[band];
+            float power = bandFirstWeight[band] * binPower[(size_t)first];
+            for (int bin = first + 1; bin < last; ++bin)
+                power += binPower[(size_t)bin];
+            power += bandLastWeight[band] * binPower[(size_t)last];
+            bandGains[band] = std::sqrt (power) * bandScale;
+        }
+        // the banks keep their state, so nothing unhealthy may get into it
+        frameRepairs += SpectralGuard::scrub (bandGains.data(), (int)bandGains.size());
+    }
+
+    // the loudest peaks of mX into framePeaks, and mX with their main lobes cut down to a straight line
+    // (in dB) between the bins either side into residualX
+    const float* removePeaks (const int numBins)
+    {
+        // the peak of a sine's lobe is amplitude * windowSum / 2
+        const float lobeGainDb = 20.0f * std::log10 (std::max (tables->windowSum, 1.0e-9f) * 0.5f);
+        numFramePeaks = PartialTracker::findPeaks (mX.data(), numBins, sinusoidThresholdDb + lobeGainDb,
+                                                   framePeaks.data(), sinusoidPartials, peakScratch.data());
+
+        std::copy (mX.begin(), mX.begin() + numBins, residualX.begin());
+        const int halfWidth = windowType == windowTypeRectangular ? 1 : 2;
+        for (int peak = 0; peak < numFramePeaks; ++peak) {
+            const int centre = (int)std::lround (framePeaks[peak].bin);
+            const int left = std::max (0, centre - halfWidth - 1);
+            const int right = std::min (numBins - 1, centre + halfWidth + 1);
+            for (int bin = left + 1; bin < right; ++bin) {
+                const float line = mX[left] + (mX[right] - mX[left]) * (float)(bin - left) / (float)(right - left);
+                residualX[bin] = std::min (residualX[bin], line);
+            }
+
+            // radians per sample and the sine's amplitude, for synthesisePartials ()
+            partialFrequencies[peak] = 2.0f * (float)M_PI * framePeaks[peak].bin / (float)fftSize;
+            partialAmplitudes[peak] = std::pow (10.0f, (framePeaks[peak].magnitudeDb - lobeGainDb) / 20.0f);
+        }
+        return residualX.data();
+    }
+
+    // stochEnv and stochphaseEnv (or the phasors) back into a frame at synthesisFrame. fromInput is false
+    // when frequencyDomainBuffer holds no analysed spectrum to pull the phasors towards (synthesiseEnvelope ())
+    void resynthesise (const bool fromInput = true)
+    {
+        if (filterKernelDirty)
+            updateFilterKernel();
+
+        const int numBins = fftSize / 2 + 1;
+        const int activeBins = binPruning ? prunedBins : numBins;
+        const int analysedBins = std::min (numBins, activeBins + 3);
+
+        // * 0.1 otherwise it is too loud
+        float noiseLevel = decimation * 0.1;
+        if (phasorPhases) {
+            applyPhasors (activeBins, noiseLevel, fromInput ? phasorBias : 0.0f);
+            inverseTransform (activeBins);
+            return;
+        }
+        // the kernel is zero from filterKernelBins on, so the noise term only exists below that
+        const int noiseBins = std::min (filterKernelBins, analysedBins);
+        for(int i = 0; i < noiseBins; ++i) {
+            randPhase = randomBins[i] * noiseLevel;
+            float filteredPhase =randPhase* filterKernel[i]  + stochphaseEnv[i];
+            filteredphase[i] = filteredPhase;
+        }
+        for (int i = noiseBins; i < analysedBins; ++i)
+            filteredphase[i] = stochphaseEnv[i];
+        //linear interpolation didn't work as expected
+        //using cubicinterpolation
+        // every step overwrites the three bins after its own with the next one, so only t = 0 is left
+        // of all but the last step
+        const int interpolatedBins = std::min (fftSize / 2 - 3, activeBins);
+        const float* v = filteredphase.data();
+        kernels->interpolate (v, v + 1, v + 2, v + 3, 0.0f, cubicfilteredPhase.data(), interpolatedBins);
+        for (int j = 1; j < 4 && interpolatedBins > 0; ++j) {
+            const int i = interpolatedBins - 1;
+            float t = static_cast<float>(j) / 3.0f;
+            cubicfilteredPhase[i + j] = cubicInterpolation(v[i], v[i + 1], v[i + 2], v[i + 3], t);
+        }
+        // the interpolation never reaches the Nyquist bin, it takes its phase as is so that
+        // no frame depends on the one before (frames can be rendered in any order, see renderFrame ())
+        for (int i = std::min (fftSize / 2 - 3, activeBins) + 3; i < activeBins; ++i)
+            cubicfilteredPhase[i] = filteredphase[i];
+        
+        //Not really sure if this is correct but a bit less sample & hold effect
+        unwrapPhase(cubicfilteredPhase.data(), activeBins);
+        
+        // the phasors' amplitudes are free without them
+        float* amplitude = phasorAmplitude.data();
+        kernels->amplitudeExact (stochEnv.data(), amplitude, activeBins);
+        for (int index = 0; index < std::min (filterKernelBins, activeBins); ++index) {
+            randPhase = randomBins[index]  * noiseLevel;
+            amplitude[index] += randPhase * filterKernel[index];
+        }
+        if (binPruning)
+            for (int index = taperStartBin; index < activeBins; ++index)
+                amplitude[index] *= pruningTaper[index - taperStartBin];
+
+        // cos / sin once, the mirrored bin is the conjugate
+        float* bins = reinterpret_cast<float*> (frequencyDomainBuffer.get());
+        kernels->polarToCartesianExact (amplitude, cubicfilteredPhase.data(), bins, bins + 1, 2, activeBins);
+        if (! binPruning)
+            for (int index = 1; index < std::min (activeBins, fftSize / 2); ++index)
+                frequencyDomainBuffer[fftSize - index] = std::conj (frequencyDomainBuffer[index]);
+
+        inverseTransform (activeBins);
+    }
+
+    // resynthesise () with the phasors from phasorStart on: the amplitudes first, then amplitude * phasor,
+    // in plain loops over the bins
+    void applyPhasors (const int activeBins, const float noiseLevel, const float bias)
+    {
+        float* amplitude = phasorAmplitude.data();
+        for (int index = 0; index < activeBins; ++index)
+            amplitude[index] = std::exp (stochEnv[index] / 20.0f);
+        for (int index = 0; index < std::min (filterKernelBins, activeBins); ++index)
+            amplitude[index] += randomBins[index] * noiseLevel * filterKernel[index];
+        if (binPruning)
+            for (int index = taperStartBin; index < activeBins; ++index)
+                amplitude[index] *= pruningTaper[index - taperStartBin];
+
+        const float* phasorRe = tables->phasorReal.data() + phasorStart;
+        const float* phasorIm = tables->phasorImag.data() + phasorStart;
+        float* bins = reinterpret_cast<float*> (frequencyDomainBuffer.get());
+        if (bias > 0.0f) {
+            // (1 - bias) phasor + bias input / |input|, back to unit length
+            for (int index = 0; index < activeBins; ++index) {
+                const float inputRe = bins[2 * index], inputIm = bins[2 * index + 1];
+                const float inputScale = bias / std::sqrt (inputRe * inputRe + inputIm * inputIm + 1.0e-30f);
+                const float re = (1.0f - bias) * phasorRe[index] + inputScale * inputRe;
+                const float im = (1.0f - bias) * phasorIm[index] + inputScale * inputIm;
+                const float scale = amplitude[index] / std::sqrt (re * re + im * im + 1.0e-30f);
+                bins[2 * index] = scale * re;
+                bins[2 * index + 1] = scale * im;
+            }
+        } else {
+            kernels->scalePhasors (amplitude, phasorRe, phasorIm, frequencyDomainBuffer.get(), activeBins);
+        }
+
+        // the mirrored bin is the conjugate
+        if (! binPruning)
+            for (int index = 1; index < std::min (activeBins, fftSize / 2); ++index)
+                frequencyDomainBuffer[fftSize - index] = std::conj (frequencyDomainBuffer[index]);
+    }
+
+    // frequencyDomainBuffer's first activeBins bins through the spectral nodes and to synthesisFrame, scrubbed
+    // before it can reach the output ring
+    void inverseTransform (const int activeBins)
+    {
+        if (! spectralNodes.empty()) {
+            for (auto& node : spectralNodes)
+                node->process (frequencyDomainBuffer.get(), activeBins);
+            // the nodes only see the lower half
+            if (! binPruning)
+                for (int index = 1; index < std::min (activeBins, fftSize / 2); ++index)
+                    frequencyDomainBuffer[fftSize - index] = std::conj (frequencyDomainBuffer[index]);
+        }
+
+        if (binPruning) {
+            // the upper band is zero and the result is real, so a half size inverse over the active bins does it
+            fft->performRealInverse (frequencyDomainBuffer.get(), synthesisFrame, activeBins, realInverseScratch.get());
+            synthesisFrameStride = 1;
+        } else {
+            fft->perform(frequencyDomainBuffer.get(), timeoutbufferBuffer.get(), true);
+            synthesisFrameStride = 2;
+        }
+        frameRepairs += SpectralGuard::scrub (synthesisFrame, fftSize, synthesisFrameStride);
+    }
+
+    // modification () for numColumns frames held [sample or bin][frame] in batchReal / batchImag, so
+    // every loop runs across the frames. Same arithmetic per frame, so the same output, but the bins
+    // are walked twice instead of six times to keep the batch in cache.
+    // A subclass overriding modification () has to override this as well, or keep batching off.
+    virtual void modificationBatch (const int numColumns)
+    {
+        float* real = batchReal.data();
+        float* imag = batchImag.data();
+        const size_t columns = (size_t)numColumns;
+        fft->performBatch (real, imag, numColumns, false);
+
+        if (filterKernelDirty)
+            updateFilterKernel();
+
+        const int numBins = fftSize / 2 + 1;
+        const int activeBins = binPruning ? prunedBins : numBins;
+        const int analysedBins = std::min (numBins, activeBins + 3);
+        lastAnalysedBins = analysedBins;
+
+        // like analyseSpectrum (): NaN / Inf and denormals out, then a floor under the magnitudes
+        int* repairs = batchRepairs.data();
+        std::fill (repairs, repairs + numColumns, 0);
+        SpectralGuard::scrubColumns (real, analysedBins, numColumns, repairs);
+        SpectralGuard::scrubColumns (imag, analysedBins, numColumns, repairs);
+
+        // magnitude, envelopes and the noisy phase
+        const float stocf = fftSize / 2 + 1 * stocfactor;
+        const float decifac = stocfactor * 100;
+        float noiseLevel = decimation * 0.1;
+        const int noiseBins = std::min (filterKernelBins, analysedBins);
+        for (int index = 0; index < analysedBins; ++index) {
+            const float* re = real + index * columns;
+            const float* im = imag + index * columns;
+            float* magnitude = batchMagnitude.data() + index * columns;
+            float* envelope = batchEnvelope.data() + index * columns;
+            float* filtered = batchFilteredPhase.data() + index * columns;
+            const float noise = index < noiseBins ? randomBins[index] * noiseLevel * filterKernel[index] : 0.0f;
+
+            if (channelLanes) {
+                // the same with LaneMath, 20 log10 |X| = 10 log10 |X|^2, which has the floor built in
+                kernels->magnitudeDb (re, im, magnitude, repairs, numColumns);
+
+                if (index < stocf && decifac > 0.0f) {
+                    for (size_t column = 0; column < columns; ++column)
+                        envelope[column] = LaneMath::fmod (magnitude[column], decifac);
+                    if (! phasorPhases)
+                        for (size_t column = 0; column < columns; ++column)
+                            filtered[column] = noise + LaneMath::fmod (LaneMath::atan2 (im[column], re[column]), decifac);
+                } else {
+                    std::fill (envelope, envelope + columns, stochEnv[index]);
+                    std::fill (filtered, filtered + columns, noise + stochphaseEnv[index]);
+                }
+                continue;
+            }
+
+            kernels->magnitudeDbExact (re, im, 1, magnitude, numColumns);
+            for (size_t column = 0; column < columns; ++column) {
+                const std::complex<float> value (re[column], im[column]);
+                const float mXValue = SpectralGuard::clampDb (magnitude[column], repairs[column]);
+                magnitude[column] = mXValue;
+
+                // bins past stocf keep their old envelopes, like modification () leaves them
+                float phaseEnvelope = stochphaseEnv[index];
+                envelope[column] = stochEnv[index];
+                if (index < stocf) {
+                    envelope[column] = fmod(mXValue, decifac);
+                    if (! phasorPhases)
+                        phaseEnvelope = fmod(arg(value), decifac);
+                }
+                filtered[column] = index < noiseBins ? noise + phaseEnvelope : phaseEnvelope;
+            }
+        }
+
+        if (phasorPhases) {
+            applyPhasorsBatch (numColumns, activeBins, noiseLevel);
+            inverseTransformBatch (numColumns, activeBins);
+            return;
+        }
+
+        // interpolate, unwrap and resynthesise, each bin as soon as the interpolation is done with it
+        const int interpolatedBins = std::min (fftSize / 2 - 3, activeBins);
+        auto finishBin = [&] (const int index) {
+            float* phase = batchCubicPhase.data() + index * columns;
+            const float* previous = phase - columns;
+            if (index >= interpolatedBins + 3) {
+                // never interpolated (the Nyquist bin without pruning), like modification ()
+                const float* filtered = batchFilteredPhase.data() + index * columns;
+                for (size_t column = 0; column < columns; ++column) {
+                    phase[column] = filtered[column];
+                    unwrapPhaseStep (phase[column], previous[column]);
+                }
+            } else if (index > 0) {
+                for (size_t column = 0; column < columns; ++column)
+                    unwrapPhaseStep (phase[column], previous[column]);
+            }
+
+            const float* envelope = batchEnvelope.data() + index * columns;
+            float* re = real + index * columns;
+            float* im = imag + index * columns;
+            const float noise = index < filterKernelBins ? randomBins[index] * noiseLevel * filterKernel[index] : 0.0f;
+            const float taper = binPruning && index >= taperStartBin ? pruningTaper[index - taperStartBin] : 1.0f;
+
+            if (channelLanes) {
+                kernels->polarToCartesian (envelope, phase, noise, taper, re, im, numColumns);
+            } else {
+                // the interpolation is done with this bin's phase plane
+                float* amplitude = batchFilteredPhase.data() + index * columns;
+                kernels->amplitudeExact (envelope, amplitude, numColumns);
+                for (size_t column = 0; column < columns; ++column)
+                    amplitude[column] = (amplitude[column] + noise) * taper;
+                kernels->polarToCartesianExact (amplitude, phase, re, im, 1, numColumns);
+            }
+
+            if (! binPruning && index > 0 && index < fftSize / 2) {
+                float* mirroredRe = real + (fftSize - index) * columns;
+                float* mirroredIm = imag + (fftSize - index) * columns;
+                for (size_t column = 0; column < columns; ++column) {
+                    mirroredRe[column] = re[column];
+                    mirroredIm[column] = -im[column];
+                }
+            }
+        };
+
+        for (int i = 0; i < interpolatedBins; ++i) {
+            const float* v0 = batchFilteredPhase.data() + i * columns;
+            const float* v1 = v0 + columns;
+            const float* v2 = v1 + columns;
+            const float* v3 = v2 + columns;
+            // like resynthesise (), t > 0 only survives from the last step
+            for (int j = 0; j < (i == interpolatedBins - 1 ? 4 : 1); ++j) {
+                float t = static_cast<float>(j) / 3.0f;
+                kernels->interpolate (v0, v1, v2, v3, t, batchCubicPhase.data() + (i + j) * columns, numColumns);
+            }
+            // later steps only write the bins above i
+            finishBin (i);
+        }
+        for (int index = std::max (0, interpolatedBins); index < activeBins; ++index)
+            finishBin (index);
+
+        inverseTransformBatch (numColumns, activeBins);
+    }
+
+    // inverseTransform () for the batch planes, the frames end up in batchReal
+    void inverseTransformBatch (const int numColumns, const int activeBins)
+    {
+        if (binPruning)
+            fft->performRealInverseBatch (batchReal.data(), batchImag.data(), numColumns, activeBins, batchScratchReal.data(), batchScratchImag.data());
+        else
+            fft->performBatch (batchReal.data(), batchImag.data(), numColumns, true);
+        SpectralGuard::scrubColumns (batchReal.data(), fftSize, numColumns, batchRepairs.data());
+    }
+
+    // applyPhasors () for the batch planes, every column from its own batchPhasorStarts
+    void applyPhasorsBatch (const int numColumns, const int activeBins, const float noiseLevel)
+    {
+        float* real = batchReal.data();
+        float* imag = batchImag.data();
+        const size_t columns = (size_t)numColumns;
+        const float* phasorRe = tables->phasorReal.data();
+        const float* phasorIm = tables->phasorImag.data();
+        const int* starts = batchPhasorStarts.data();
+
+        for (int index = 0; index < activeBins; ++index) {
+            const float* envelope = batchEnvelope.data() + index * columns;
+            // the phase planes are free with the phasors
+            float* amplitude = batchFilteredPhase.data() + index * columns;
+            float* re = real + index * columns;
+            float* im = imag + index * columns;
+            const float noise = index < filterKernelBins ? randomBins[index] * noiseLevel * filterKernel[index] : 0.0f;
+            const float taper = binPruning && index >= taperStartBin ? pruningTaper[index - taperStartBin] : 1.0f;
+
+            if (channelLanes) {
+                for (size_t column = 0; column < columns; ++column)
+                    amplitude[column] = (LaneMath::exp (envelope[column] / 20.0f) + noise) * taper;
+            } else {
+                for (size_t column = 0; column < columns; ++column)
+                    amplitude[column] = (std::exp (envelope[column] / 20.0f) + noise) * taper;
+            }
+
+            if (phasorBias > 0.0f) {
+                for (size_t column = 0; column < columns; ++column) {
+                    const float inputScale = phasorBias / std::sqrt (re[column] * re[column] + im[column] * im[column] + 1.0e-30f);
+                    const float phaseRe = (1.0f - phasorBias) * phasorRe[starts[column] + index] + inputScale * re[column];
+                    const float phaseIm = (1.0f - phasorBias) * phasorIm[starts[column] + index] + inputScale * im[column];
+                    const float scale = amplitude[column] / std::sqrt (phaseRe * phaseRe + phaseIm * phaseIm + 1.0e-30f);
+                    re[column] = scale * phaseRe;
+                    im[column] = scale * phaseIm;
+                }
+            } else {
+                for (size_t column = 0; column < columns; ++column) {
+                    re[column] = amplitude[column] * phasorRe[starts[column] + index];
+                    im[column] = amplitude[column] * phasorIm[starts[column] + index];
+                }
+            }
+
+            if (! binPruning && index > 0 && index < fftSize / 2) {
+                float* mirroredRe = real + (fftSize - index) * columns;
+                float* mirroredIm = imag + (fftSize - index) * columns;
+                for (size_t column = 0; column < columns; ++column) {
+                    mirroredRe[column] = re[column];
+                    mirroredIm[column] = -im[column];
+                }
+            }
+        }
+    }
+
+    // cutoff, sample rate or fftSize changed: rebuild the kernel once instead of every hop
+    void updateFilterKernel()
+    {
+        const float cutoffFrequency = cutoff; // choose a cutoff frequency in Hz
+        const int windowSize = fftSize / 2 - 1; // get the size of the frequency domain buffer
+        const int numBins = fftSize / 2 + 1;
+        // create a low-pass filter kernel using Hann window
+
+        filterKernelBins = 0;
+        for (int i = 0; i < windowSize; ++i) {
+            float frequency = (float(i) / (windowSize - 1)) * sampleRate;
+            float normalizedFrequency = frequency / cutoffFrequency;
+            if (normalizedFrequency > 1.0f) {
+                filterKernel[i] = 0.0f;
+            } else {
+                float hannFactor = 0.5f * (1.0f - std::cos(2.0f * M_PI * normalizedFrequency));
+                filterKernel[i] = hannFactor;
+                filterKernelBins = i + 1;
+            }
+        }
+        for (int i = windowSize; i < numBins; ++i)
+            filterKernel[i] = 0.0f;
+
+        // raised cosine from the cutoff bin down to zero. The kernel above maps bin i to about twice its
+        // frequency, the pruning goes by the bin the cutoff actually falls in
+        const int cutoffBin = (int)std::ceil ((double)cutoffFrequency * fftSize / sampleRate);
+        taperStartBin = std::min (numBins, std::max (1, cutoffBin));
+        const int taperBins = std::max (8, taperStartBin / 8);
+        prunedBins = std::min (numBins, taperStartBin + taperBins);
+        for (int i = 0; i < prunedBins - taperStartBin; ++i)
+            pruningTaper[i] = 0.5f + 0.5f * std::cos ((float)M_PI * (float)(i + 1) / (float)(taperBins + 1));
+
+        filterKernelDirty = false;
+    }
+
+    
+    inline float cubicInterpolation(float y0, float y1, float y2, float y3, float x) {
+        const float a0 = y3 - y2 - y0 + y1;
+        const float a1 = y0 - y1 - a0;
+        const float a2 = y2 - y0;
+        const float a3 = y1;
+        return a0 * x * x * x + a1 * x * x + a2 * x + a3;
+    }
+
+    void unwrapPhase(float* phase, int size)
+    {
+        for (int i = 1; i < size; i++)
+            unwrapPhaseStep (phase[i], phase[i-1]);
+    }
+
+    // splitmix64, one step
+    static uint64_t splitMix (uint64_t& state) noexcept
+    {
+        uint64_t bits = (state += 0x9e3779b97f4a7c15ull);
+        bits = (bits ^ (bits >> 30)) * 0xbf58476d1ce4e5b9ull;
+        bits = (bits ^ (bits >> 27)) * 0x94d049bb133111ebull;
+        return bits ^ (bits >> 31);
+    }
+
+    // where a frame's run of phasors starts in the table, anywhere it still fits
+    int phasorOffset (uint64_t seed) const noexcept
+    {
+        const uint64_t positions = (uint64_t)(tables->phasorReal.size() - (size_t)(fftSize / 2 + 1) + 1);
+        return (int)((splitMix (seed) >> 32) % positions);
+    }
+
+    // the phases of a frame without analysed ones (synthesiseEnvelope (), envelope decimation), from seed alone
+    void drawPhases (const uint64_t seed)
+    {
+        if (phasorPhases) {
+            phasorStart = phasorOffset (seed);
+            return;
+        }
+        // uniform in [-pi, pi) like arg ()
+        uint64_t state = seed;
+        for (int index = 0; index < fftSize / 2 + 1; ++index)
+            stochphaseEnv[index] = (float)(splitMix (state) >> 40) * (float)(2.0 * M_PI / 16777216.0) - (float)M_PI;
+    }
+
+    static inline void unwrapPhaseStep (float& phase, const float previous)
+    {
+        float diff = phase - previous;
+        if (diff > M_PI) {
+            phase -= 2.0f * M_PI;
+        } else if (diff < -M_PI) {
+            phase += 2.0f * M_PI;
+        }
+    }
+
+
+
+    // The partials of the frame just synthesised (or skipped) play from its centre one hop back to its
+    // centre, in output time: analysis centre + fftSize like the frame itself. That is half a frame
+    // past where synthesis () started adding, and the write position has already moved on by a hop.
+    void synthesisePartials (const int channel, const bool silent)
+    {
+        PartialTracker& tracker = partialTrackers[channel];
+        // two bins either way is still the same partial
+        tracker.update (partialFrequencies.data(), partialAmplitudes.data(), silent ? 0 : numFramePeaks,
+                        4.0f * (float)M_PI / (float)fftSize);
+        std::fill (partialHop.begin(), partialHop.end(), 0.0f);
+        tracker.render (partialHop.data(), hopSize);
+
+        float* ring = outputBuffer[channel].data();
+        int outputBufferIndex = (currentOutputBufferWritePosition + fftSize / 2 - 2 * hopSize + 2 * outputBufferLength) % outputBufferLength;
+        for (int index = 0; index < hopSize; ++index) {
+            ring[outputBufferIndex] += partialHop[(size_t)index];
+            if (++outputBufferIndex >= outputBufferLength)
+                outputBufferIndex = 0;
+        }
+        numFramePeaks = 0;
+    }
+
+    // frame[index * frameStride] is the resynthesised frame, from modification () or modificationBatch ()
+    void synthesis (const int channel, const float* frame, const int frameStride)
+    {
+        float* ring = outputBuffer[channel].data();
+        const int firstSpan = outputBufferLength - currentOutputBufferWritePosition;
+        kernels->overlapAdd (ring + currentOutputBufferWritePosition, frame, frameStride, windowScaleFactor, firstSpan);
+        kernels->overlapAdd (ring, frame + (size_t)firstSpan * frameStride, frameStride, windowScaleFactor, fftSize - firstSpan);
+
+        currentOutputBufferWritePosition += hopSize;
+        if (currentOutputBufferWritePosition >= outputBufferLength)
+            currentOutputBufferWritePosition = 0;
+    }
+    
+  
+protected:
+    std::unique_ptr<std::complex<float>[]> timeDomainBuffer;
+    std::unique_ptr<std::complex<float>[]> frequencyDomainBuffer;
+
+    std::unique_ptr<std::complex<float>[]> timeoutbufferBuffer;
+    std::unique_ptr<std::complex<float>[]> realInverseScratch;
+    // fftSize / 2 + 1 of each, see updateFftSize ()
+    std::vector<float> stochEnv;
+    std::vector<float> stochphaseEnv;
+    std::vector<float> mX;
+    std::vector<float> filterKernel;
+    std::vector<float> pruningTaper;
+    std::vector<float> filteredphase;
+    std::vector<float> cubicfilteredPhase;
+    float cutoff = 10;
+    float sampleRate = 44100.0f;
+    bool filterKernelDirty = true;
+    int filterKernelBins = 0;
+    bool binPruning = false;
+    int prunedBins = 0;
+    int taperStartBin = 0;
+    float* synthesisFrame = nullptr;
+    int synthesisFrameStride = 2;
+    // phasor phases, see updatePhasors ()
+    bool phasorPhases = false;
+    float phasorBias = 0.0f;
+    int phasorStart = 0;
+    // hops since clearState () per channel, skipped ones too: frame k of a channel gets phasors k
+    std::vector<uint64_t> hopCounts;
+    std::vector<float> phasorAmplitude;
+
+    // frame batching, see processBatch ()
+    static constexpr int minBatchFrames = 4;
+    static constexpr int maxBatchFrames = 32;
+    static constexpr int maxBatchSamples = 4096;
+    static constexpr int laneWidth = 4;
+    bool channelLanes = false;
+    bool frameBatching = false;
+    int maxBlockSize = 0;
+    int batchCapacity = 0;
+    std::vector<float> batchReal;
+    std::vector<float> batchImag;
+    std::vector<float> batchScratchReal;
+    std::vector<float> batchScratchImag;
+    std::vector<float> batchMagnitude;
+    std::vector<float> batchEnvelope;
+    std::vector<float> batchFilteredPhase;
+    std::vector<float> batchCubicPhase;
+    // where every column's phasors start, see updatePhasors ()
+    std::vector<int> batchPhasorStarts;
+    std::vector<int> batchBoundaries;
+    std::vector<int> batchColumns;
+
+    // sinusoids, see updateSinusoids ()
+    int sinusoidMaxPartials = 0;
+    int sinusoidPartials = 0;
+    float sinusoidThresholdDb = -70.0f;
+    std::vector<PartialTracker> partialTrackers;
+    // filter bank synthesis, see updateFilterBank ()
+    int filterBankBands = 0;
+    std::vector<NoiseFilterBank> noiseBanks;
+    std::vector<int> bandFirstBin, bandLastBin;
+    std::vector<float> bandFirstWeight, bandLastWeight;
+    std::vector<float> binPower, bandGains, silentBands;
+    float bandScale = 0.0f;
+    std::vector<PartialTracker::Peak> framePeaks;
+    std::vector<PartialTracker::Peak> peakScratch;
+    std::vector<float> partialFrequencies;
+    std::vector<float> partialAmplitudes;
+    std::vector<float> residualX;
+    std::vector<float> partialHop;
+    int numFramePeaks = 0;
+    // sliding DFT, see updateSlidingDft () and allocateSliding (). [term * (fftSize / 2 + 1) + bin],
+    // the states per channel. slidingBins is how many bins of a channel are running, 0 = stopped
+    bool slidingDft = false;
+    int slidingTerms = 0;
+    double slidingCentre = 1.0;
+    double slidingSide = 0.0;
+    std::vector<double> slidingRotationRe, slidingRotationIm;
+    std::vector<std::vector<double>> slidingStateRe, slidingStateIm;
+    std::vector<int> slidingBins;
+    std::vector<std::complex<float>> slidingModulation;
+    // envelope decimation, see updateEnvelopeDecimation () and decimatedModification (). envelopeSteps is
+    // how many hops of a channel's ramp from envelopeFrom to envelopeTo have gone by, -1 = nothing analysed
+    static constexpr int maxEnvelopeInterval = 16;
+    static constexpr int fluxDecimation = 8;
+    static constexpr int minFluxSize = 32;
+    static constexpr int fluxBands = 16;
+    int envelopeInterval = 1;
+    float envelopeFluxThreshold = 0.0f;
+    int envelopeHops = 1;
+    std::vector<std::vector<float>> envelopeFrom, envelopeTo;
+    std::vector<int> envelopeSteps;
+    int fluxSize = 0;
+    std::shared_ptr<const STFTTables> fluxTables;
+    std::vector<std::vector<float>> fluxReference;
+    std::vector<float> fluxLevels;
+    // after the stochastic resynthesis, see updateSpectralNodes ()
+    std::vector<std::unique_ptr<SpectralNode>> spectralNodes;
+     //======================================
+    int numChannels;
+    int numSamples;
+    float stocfactor = 0.5;
+    float randPhase = 0;
+    float previousPhase = 0;
+    float decimation = 0;
+    int fftSize = 0;
+    int windowType = windowTypeHann;
+    std::shared_ptr<const STFTTables> tables;
+    const FFT* fft = nullptr;
+    const DspKernels* kernels = &DspKernels::get();
+
+    int inputBufferLength;
+    std::vector<std::vector<float>> inputBuffer;
+    int outputBufferLength;
+    std::vector<std::vector<float>> outputBuffer;
+    const float* fftWindow = nullptr;
+    const float* randomBins = nullptr;
+
+    float silenceThreshold = 1.0e-6f; // -120 dBFS
+    std::vector<std::vector<float>> hopPeaks;
+    std::vector<float> runningHopPeak;
+    std::vector<int> silentFrames;
+    int hopPeakIndex = 0;
+    int currentHopPeakIndex = 0;
+    std::atomic<uint64_t> framesTotal { 0 };
+    std::atomic<uint64_t> framesSkipped { 0 };
+    std::atomic<uint64_t> framesRepaired { 0 };
+    std::atomic<uint64_t> valuesRepaired { 0 };
+    // SpectralGuard repairs in the frame being made, per column in a batch
+    int frameRepairs = 0;
+    std::vector<int> batchRepairs;
+
+    bool telemetryEnabled = false;
+    int lastAnalysedBins = 0;
+    const int* telemetryBins = nullptr;
+    SpectrumTap ownSpectrumTap;
+    SpectrumTap* spectrumTap = &ownSpectrumTap;
+    
+    int overlap;
+    int hopSize;
+    float windowScaleFactor;
+    int inputBufferWritePosition;
+    int outputBufferWritePosition;
+    int outputBufferReadPosition;
+    int samplesSinceLastFFT;
+    int currentInputBufferWritePosition;
+    int currentOutputBufferWritePosition;
+    int currentOutputBufferReadPosition;
+    int currentSamplesSinceLastFFT;
+};
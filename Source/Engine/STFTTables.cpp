@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    STFTTables.cpp
+    Created: 16 Apr 2023 11:31:48am
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "STFTTables.h"
+#include "STFT.h"
+#include <future>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+STFTTables::STFTTables (int newFftSize, int newWindowType, double newSampleRate)
+    : fftSize (newFftSize),
+      windowType (newWindowType),
+      sampleRate (newSampleRate),
+      fft ((int)std::log2 (newFftSize))
+{
+    window.assign (fftSize, 0.0f);
+    switch (windowType) {
+        case STFT::windowTypeRectangular: {
+            for (int sample = 0; sample < fftSize; ++sample)
+                window[sample] = 1.0f;
+            break;
+        }
+        case STFT::windowTypeBartlett: {
+            for (int sample = 0; sample < fftSize; ++sample)
+                window[sample] = 1.0f - fabs (2.0f * (float)sample / (float)(fftSize - 1) - 1.0f);
+            break;
+        }
+        case STFT::windowTypeHann: {
+            for (int sample = 0; sample < fftSize; ++sample)
+                window[sample] = 0.5f - 0.5f * cosf (2.0f * M_PI * (float)sample / (float)(fftSize - 1));
+            break;
+        }
+        case STFT::windowTypeHamming: {
+            for (int sample = 0; sample < fftSize; ++sample)
+                window[sample] = 0.54f - 0.46f * cosf (2.0f * M_PI * (float)sample / (float)(fftSize - 1));
+            break;
+        }
+    }
+
+    for (int sample = 0; sample < fftSize; ++sample)
+        windowSum += window[sample];
+
+    // the random table is shorter than the biggest spectra, wrap around it
+    const int numBins = fftSize / 2 + 1;
+    const int randomTableSize = (int)(sizeof (randomTable) / sizeof (randomTable[0]));
+    randomBins.resize (numBins);
+    for (int i = 0; i < numBins; ++i)
+        randomBins[i] = randomTable[i % randomTableSize];
+
+    // the only cos / sin the phasor phases ever need, a fixed sequence so every run sounds the same
+    phasorReal.resize ((size_t)phasorBins * numBins);
+    phasorImag.resize ((size_t)phasorBins * numBins);
+    uint32_t state = 0x2545f491u;
+    for (size_t i = 0; i < phasorReal.size(); ++i) {
+        state = state * 1664525u + 1013904223u;
+        const double angle = 2.0 * M_PI * (double)(state >> 8) / 16777216.0;
+        phasorReal[i] = (float)std::cos (angle);
+        phasorImag[i] = (float)std::sin (angle);
+    }
+
+    const float rate = (float)sampleRate;
+    telemetryBins.resize (SpectrumSnapshot::numPoints + 1);
+    for (int point = 0; point < SpectrumSnapshot::numPoints; ++point) {
+        const float frequency = SpectrumSnapshot::getPointFrequency (point, rate);
+        telemetryBins[point] = std::min (numBins, (int)(frequency * (float)fftSize / rate));
+    }
+    telemetryBins[SpectrumSnapshot::numPoints] = numBins;
+}
+
+//==============================================================================
+namespace
+{
+    using TableKey = std::tuple<int, int, double>;
+    using TablePointer = std::shared_ptr<const STFTTables>;
+
+    struct TableCache
+    {
+        std::mutex lock;
+        // weak, so the tables go away with the last STFT using them
+        std::map<TableKey, std::weak_ptr<const STFTTables>> tables;
+        std::map<TableKey, std::shared_future<TablePointer>> pending;
+    };
+
+    TableCache& getTableCache()
+    {
+        static TableCache cache;
+        return cache;
+    }
+}
+
+std::shared_ptr<const STFTTables> STFTTables::acquire (int fftSize, int windowType, double sampleRate)
+{
+    TableCache& cache = getTableCache();
+    const TableKey key { fftSize, windowType, sampleRate };
+    std::promise<TablePointer> build;
+    std::unique_lock<std::mutex> guard (cache.lock);
+
+    for (auto entry = cache.tables.begin(); entry != cache.tables.end();)
+        entry = entry->second.expired() ? cache.tables.erase (entry) : std::next (entry);
+
+    auto existing = cache.tables.find (key);
+    if (existing != cache.tables.end())
+        if (auto tables = existing->second.lock())
+            return tables;
+
+    auto building = cache.pending.find (key);
+    if (building != cache.pending.end()) {
+        // someone else is building this key, wait for them outside the lock
+        auto result = building->second;
+        guard.unlock();
+        return result.get();
+    }
+
+    cache.pending[key] = build.get_future().share();
+    guard.unlock();
+
+    TablePointer tables;
+    try {
+        tables = std::make_shared<const STFTTables> (fftSize, windowType, sampleRate);
+    } catch (...) {
+        guard.lock();
+        cache.pending.erase (key);
+        build.set_exception (std::current_exception());
+        throw;
+    }
+
+    guard.lock();
+    cache.tables[key] = tables;
+    cache.pending.erase (key);
+    build.set_value (tables);
+    return tables;
+}
+
+int STFTTables::getNumLiveTables()
+{
+    TableCache& cache = getTableCache();
+    std::lock_guard<std::mutex> guard (cache.lock);
+
+    int numLive = 0;
+    for (auto& entry : cache.tables)
+        if (! entry.second.expired())
+            ++numLive;
+    return numLive;
+}
@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    STFTTables.h
+    Created: 16 Apr 2023 11:31:48am
+    Author:  Onez
+
+    Everything an STFT needs that only depends on (fftSize, window type,
+    sample rate): the FFT plan, the analysis window, the wrapped random
+    table, the random phasors and the telemetry bin edges. One set of
+    tables is shared by every STFT in the process with the same key, and
+    freed when the last one lets go of it.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <memory>
+#include <vector>
+#include "FFT.h"
+#include "SpectrumTap.h"
+
+class STFTTables
+{
+public:
+    STFTTables (int fftSize, int windowType, double sampleRate);
+
+    // Returns the shared tables for this key, building them on the calling thread if nobody
+    // has them yet. Callers racing for the same key wait for a single build. Not for the audio thread.
+    static std::shared_ptr<const STFTTables> acquire (int fftSize, int windowType, double sampleRate);
+    // number of distinct table sets currently alive, for diagnostics
+    static int getNumLiveTables();
+
+    const int fftSize;
+    const int windowType;
+    const double sampleRate;
+
+    const FFT fft;
+    std::vector<float> window;
+    float windowSum = 0.0f;
+    // randomTable repeated up to fftSize / 2 + 1 bins
+    std::vector<float> randomBins;
+    // unit phasors at random angles, phasorBins * (fftSize / 2 + 1) of them. A frame takes its phases
+    // from fftSize / 2 + 1 consecutive ones starting anywhere, see STFT::updatePhasors ()
+    static constexpr int phasorBins = 4;
+    std::vector<float> phasorReal, phasorImag;
+    // first bin of every SpectrumSnapshot point, plus the end
+    std::vector<int> telemetryBins;
+};
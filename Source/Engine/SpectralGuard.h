@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    SpectralGuard.h
+    Created: 8 Jun 2023 7:41:22pm
+    Author:  Onez
+
+    Numeric health checks for the STFT's buffers. A bin of exactly zero
+    gives 20 log10 (0) = -inf, fmod () turns that into NaN, and a NaN
+    that reaches the output ring stays there until the next reset. These
+    put a floor under the magnitudes and turn NaN, Inf and denormals into
+    zeros. Every function returns (or adds up per column) how many values
+    it had to change, for the repair counters. The loops only select, so
+    the compiler vectorises them and they can stay on all the time.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace SpectralGuard
+{
+    // The floor for magnitudes in dB, the same one LaneMath::log10 () has (1e-30 on a power)
+    constexpr float magnitudeFloorDb = -300.0f;
+    constexpr float powerFloor = 1.0e-30f;
+
+    // NaN, Inf or denormal (zeros are fine)
+    inline bool isUnhealthy (float value) noexcept
+    {
+        uint32_t bits;
+        std::memcpy (&bits, &value, sizeof (bits));
+        const uint32_t exponent = bits & 0x7f800000u;
+        return exponent == 0x7f800000u || (exponent == 0 && (bits & 0x7fffffffu) != 0);
+    }
+
+    // values[index * stride] for count values: NaN, Inf and denormals to zero, returns how many
+    inline int scrub (float* values, const int count, const int stride = 1) noexcept
+    {
+        int repairs = 0;
+        for (int index = 0; index < count; ++index) {
+            float& value = values[(size_t)index * stride];
+            const bool unhealthy = isUnhealthy (value);
+            value = unhealthy ? 0.0f : value;
+            repairs += unhealthy ? 1 : 0;
+        }
+        return repairs;
+    }
+
+    // scrub () over numRows rows of numColumns, [row][column], each column's count added to repairs[column]
+    inline void scrubColumns (float* values, const int numRows, const int numColumns, int* repairs) noexcept
+    {
+        for (int row = 0; row < numRows; ++row) {
+            float* rowValues = values + (size_t)row * numColumns;
+            for (int column = 0; column < numColumns; ++column) {
+                const bool unhealthy = isUnhealthy (rowValues[column]);
+                rowValues[column] = unhealthy ? 0.0f : rowValues[column];
+                repairs[column] += unhealthy ? 1 : 0;
+            }
+        }
+    }
+
+    // a magnitude in dB: below the floor, -inf and NaN to the floor, counted in repairs
+    inline float clampDb (const float valueDb, int& repairs) noexcept
+    {
+        // false for NaN as well
+        const bool healthy = valueDb >= magnitudeFloorDb;
+        repairs += healthy ? 0 : 1;
+        return healthy ? valueDb : magnitudeFloorDb;
+    }
+
+    inline int clampDb (float* valuesDb, const int count) noexcept
+    {
+        int repairs = 0;
+        for (int index = 0; index < count; ++index)
+            valuesDb[index] = clampDb (valuesDb[index], repairs);
+        return repairs;
+    }
+}
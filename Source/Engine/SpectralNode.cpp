@@ -0,0 +1,119 @@
+/*
+  ==============================================================================
+
+    SpectralNode.cpp
+    Created: 19 Jun 2023 6:12:40pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "SpectralNode.h"
+#include <algorithm>
+#include <cmath>
+
+std::unique_ptr<SpectralNode> SpectralNode::create (int type)
+{
+    switch (type) {
+        case typeGate: return std::make_unique<SpectralGate>();
+        case typeTilt: return std::make_unique<SpectralTilt>();
+        default:       return nullptr;
+    }
+}
+
+SpectralNode::Settings SpectralNode::getDefaultSettings (int type) noexcept
+{
+    switch (type) {
+        case typeTilt: return { typeTilt, { 0.0f, 1000.0f } };
+        default:       return { typeGate, { -60.0f, 80.0f } };
+    }
+}
+
+//==============================================================================
+void SpectralGate::prepare (double, int, float windowSum)
+{
+    fullScale = windowSum * 0.5f;
+    updateGains();
+}
+
+void SpectralGate::setParameter (int index, float value) noexcept
+{
+    if (index == thresholdDb) {
+        value = std::min (0.0f, std::max (-120.0f, value));
+        if (value != threshold) {
+            threshold = value;
+            updateGains();
+        }
+    } else if (index == depthDb) {
+        value = std::min (120.0f, std::max (0.0f, value));
+        if (value != depth) {
+            depth = value;
+            updateGains();
+        }
+    }
+}
+
+void SpectralGate::updateGains() noexcept
+{
+    const float level = std::pow (10.0f, threshold / 20.0f) * fullScale;
+    thresholdPower = level * level;
+    floorGain = std::pow (10.0f, -depth / 20.0f);
+}
+
+void SpectralGate::process (std::complex<float>* bins, int numBins) noexcept
+{
+    // powers against the threshold, no square roots
+    float* values = reinterpret_cast<float*> (bins);
+    for (int index = 0; index < numBins; ++index) {
+        const float re = values[2 * index], im = values[2 * index + 1];
+        const float gain = re * re + im * im < thresholdPower ? floorGain : 1.0f;
+        values[2 * index] = re * gain;
+        values[2 * index + 1] = im * gain;
+    }
+}
+
+//==============================================================================
+void SpectralTilt::prepare (double sampleRate, int fftSize, float)
+{
+    binWidth = fftSize > 0 ? sampleRate / fftSize : 0.0;
+    gains.assign ((size_t)(fftSize / 2 + 1), 1.0f);
+    gainsDirty = true;
+}
+
+void SpectralTilt::setParameter (int index, float value) noexcept
+{
+    if (index == slopeDb) {
+        value = std::min (12.0f, std::max (-12.0f, value));
+        gainsDirty = gainsDirty || value != slope;
+        slope = value;
+    } else if (index == pivotFrequency) {
+        value = std::min (20000.0f, std::max (20.0f, value));
+        gainsDirty = gainsDirty || value != pivot;
+        pivot = value;
+    }
+}
+
+void SpectralTilt::updateGains() noexcept
+{
+    // DC has no octave, it gets the gain half a bin up
+    for (size_t bin = 0; bin < gains.size(); ++bin) {
+        const double frequency = std::max (0.5, (double)bin) * binWidth;
+        gains[bin] = (float)std::pow (10.0, slope * std::log2 (frequency / pivot) / 20.0);
+    }
+    gainsDirty = false;
+}
+
+void SpectralTilt::process (std::complex<float>* bins, int numBins) noexcept
+{
+    if (slope == 0.0f)
+        return;
+    if (gainsDirty)
+        updateGains();
+
+    float* values = reinterpret_cast<float*> (bins);
+    const int count = std::min (numBins, (int)gains.size());
+    for (int index = 0; index < count; ++index) {
+        values[2 * index] *= gains[(size_t)index];
+        values[2 * index + 1] *= gains[(size_t)index];
+    }
+}
@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    SpectralNode.h
+    Created: 19 Jun 2023 6:12:40pm
+    Author:  Onez
+
+    Spectral effects that share the STFT's transforms. The stochastic
+    resynthesis is always the first node of a frame. The nodes added with
+    StocSynthEngine::addSpectralNode () follow it in order, each working in
+    place on the bins it left in frequencyDomainBuffer, and then the one
+    inverse FFT runs. A chain of them costs a loop over the bins each,
+    instead of an FFT pair and a frame of latency each. Every STFT (the
+    governor's tiers, the offline workers) makes its own nodes for its FFT
+    size from the same Settings. A node sees one frame at a time and keeps
+    nothing from one to the next, so frames can still be rendered in any
+    order (see OfflineRenderer).
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <complex>
+#include <memory>
+#include <vector>
+
+class SpectralNode
+{
+public:
+    enum Type {
+        typeGate = 0,
+        typeTilt,
+        numTypes
+    };
+    static constexpr int maxParameters = 2;
+
+    // a node as the engine keeps it and hands it to every STFT
+    struct Settings
+    {
+        int type;
+        float parameters[maxParameters];
+    };
+
+    virtual ~SpectralNode() {}
+
+    // a node of this type, nullptr if there is no such type
+    static std::unique_ptr<SpectralNode> create (int type);
+    // the type with its default parameters
+    static Settings getDefaultSettings (int type) noexcept;
+
+    // The STFT's rate and FFT size, and the sum of its window: a full scale sine peaks at windowSum / 2
+    // in its bin. Before the first frame and whenever one of them changes. Allocates
+    virtual void prepare (double sampleRate, int fftSize, float windowSum) = 0;
+    // the STFT passes every parameter on once a block, so this has to be cheap when nothing changed.
+    // Out of range values are clamped
+    virtual void setParameter (int index, float value) noexcept = 0;
+    // bins[0 .. numBins) of one frame in place: fftSize / 2 + 1 of them, or fewer with bin pruning.
+    // The STFT mirrors the upper half afterwards
+    virtual void process (std::complex<float>* bins, int numBins) noexcept = 0;
+};
+
+// Bins quieter than the threshold are turned down by depth dB. The threshold is in dBFS of a sine in
+// the bin, before the Amp gain
+class SpectralGate : public SpectralNode
+{
+public:
+    enum Parameter {
+        thresholdDb = 0,    // -120 .. 0, default -60
+        depthDb             // 0 .. 120, default 80
+    };
+
+    void prepare (double sampleRate, int fftSize, float windowSum) override;
+    void setParameter (int index, float value) noexcept override;
+    void process (std::complex<float>* bins, int numBins) noexcept override;
+
+private:
+    void updateGains() noexcept;
+
+    float threshold = -60.0f;
+    float depth = 80.0f;
+    float fullScale = 1.0f;
+    // power of a bin at the threshold, and the gain below it
+    float thresholdPower = 0.0f;
+    float floorGain = 0.0f;
+};
+
+// A straight line in dB over log frequency: slope dB per octave, 0 dB at the pivot
+class SpectralTilt : public SpectralNode
+{
+public:
+    enum Parameter {
+        slopeDb = 0,        // per octave, -12 .. 12, default 0
+        pivotFrequency      // Hz, 20 .. 20000, default 1000
+    };
+
+    void prepare (double sampleRate, int fftSize, float windowSum) override;
+    void setParameter (int index, float value) noexcept override;
+    void process (std::complex<float>* bins, int numBins) noexcept override;
+
+private:
+    void updateGains() noexcept;
+
+    float slope = 0.0f;
+    float pivot = 1000.0f;
+    double binWidth = 0.0;
+    // per bin, rebuilt by the next frame after a parameter changed
+    std::vector<float> gains;
+    bool gainsDirty = true;
+};
@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    SpectrumTap.h
+    Created: 9 Apr 2023 2:47:10pm
+    Author:  Onez
+
+    Per-hop spectrum snapshots from the audio thread to the editor.
+    TripleBuffer is wait-free on both sides: the writer always owns one
+    slot, the reader another, and they swap through the third one.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+template <typename Type>
+class TripleBuffer
+{
+public:
+    // writer side (audio thread): fill getWriteBuffer (), then publish ()
+    Type& getWriteBuffer() noexcept { return buffers[writeIndex]; }
+
+    void publish() noexcept
+    {
+        writeIndex = shared.exchange (writeIndex | freshFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // reader side (message thread): true if a newer snapshot was swapped in
+    bool update() noexcept
+    {
+        if ((shared.load (std::memory_order_relaxed) & freshFlag) == 0)
+            return false;
+
+        readIndex = shared.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const Type& getReadBuffer() const noexcept { return buffers[readIndex]; }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshFlag = 4;
+
+    std::array<Type, 3> buffers {};
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> shared { 2 };
+};
+
+//==============================================================================
+// magnitude and envelope are in dB, kernel is the 0..1 noise low-pass
+struct SpectrumSnapshot
+{
+    static constexpr int numPoints = 256;
+    // points are spaced logarithmically from minFrequency up to sampleRate / 2
+    static constexpr float minFrequency = 20.0f;
+
+    float magnitude[numPoints];
+    float envelope[numPoints];
+    float kernel[numPoints];
+    float sampleRate = 44100.0f;
+    int fftSize = 0;
+    bool silent = true;
+    uint64_t frame = 0;
+
+    static float getPointFrequency (int point, float sampleRate) noexcept;
+};
+
+inline float SpectrumSnapshot::getPointFrequency (int point, float sampleRate) noexcept
+{
+    const float maxFrequency = 0.5f * sampleRate;
+    return minFrequency * std::pow (maxFrequency / minFrequency, (float)point / (float)(numPoints - 1));
+}
+
+using SpectrumTap = TripleBuffer<SpectrumSnapshot>;
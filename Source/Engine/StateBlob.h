@@ -0,0 +1,105 @@
+/*
+  ==============================================================================
+
+    StateBlob.h
+    Created: 6 Jun 2023 9:12:40pm
+    Author:  Onez
+
+    The binary format of StocSynthEngine::saveState (): values and vectors
+    of trivially copyable types, back to back in native byte order, a
+    vector prefixed with its length. Only meant to be read back by the
+    same build on the same kind of machine.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+class StateWriter
+{
+public:
+    explicit StateWriter (std::vector<uint8_t>& destination) : data (destination) {}
+
+    template <typename Value>
+    void write (const Value& value)
+    {
+        static_assert (std::is_trivially_copyable<Value>::value, "raw bytes only");
+        const auto* bytes = reinterpret_cast<const uint8_t*> (&value);
+        data.insert (data.end(), bytes, bytes + sizeof (Value));
+    }
+
+    template <typename Value>
+    void write (const std::vector<Value>& values)
+    {
+        static_assert (std::is_trivially_copyable<Value>::value, "raw bytes only");
+        write ((uint64_t)values.size());
+        const auto* bytes = reinterpret_cast<const uint8_t*> (values.data());
+        data.insert (data.end(), bytes, bytes + values.size() * sizeof (Value));
+    }
+
+private:
+    std::vector<uint8_t>& data;
+};
+
+class StateReader
+{
+public:
+    StateReader (const void* source, size_t sourceSize) : data (static_cast<const uint8_t*> (source)), size (sourceSize) {}
+
+    // false as soon as something did not fit, every read after that leaves its target alone
+    bool isValid() const noexcept { return valid; }
+    bool isAtEnd() const noexcept { return valid && position == size; }
+
+    template <typename Value>
+    void read (Value& value) noexcept
+    {
+        static_assert (std::is_trivially_copyable<Value>::value, "raw bytes only");
+        if (! take (sizeof (Value)))
+            return;
+        std::memcpy (&value, data + position - sizeof (Value), sizeof (Value));
+    }
+
+    // into a vector of the stored size only, so loading never allocates: the layout comes from prepare ()
+    template <typename Value>
+    void read (std::vector<Value>& values) noexcept
+    {
+        static_assert (std::is_trivially_copyable<Value>::value, "raw bytes only");
+        uint64_t count = 0;
+        read (count);
+        if (! valid || count != values.size()) {
+            valid = false;
+            return;
+        }
+        if (values.empty() || ! take (values.size() * sizeof (Value)))
+            return;
+        std::memcpy (values.data(), data + position - values.size() * sizeof (Value), values.size() * sizeof (Value));
+    }
+
+    // a value that has to match what the reader already has, like a size or a setting
+    template <typename Value>
+    void expect (const Value& value) noexcept
+    {
+        Value stored {};
+        read (stored);
+        valid = valid && std::memcmp (&stored, &value, sizeof (Value)) == 0;
+    }
+
+private:
+    bool take (size_t count) noexcept
+    {
+        valid = valid && count <= size - position;
+        if (valid)
+            position += count;
+        return valid;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    bool valid = true;
+};
@@ -0,0 +1,928 @@
+/*
+  ==============================================================================
+
+    StocSynthEngine.cpp
+    Created: 2 Apr 2023 5:03:41pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "StocSynthEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "OfflineRenderer.h"
+
+StocSynthEngine::StocSynthEngine()
+{
+    sTFT = std::make_unique<STFT>();
+}
+
+StocSynthEngine::~StocSynthEngine()
+{
+}
+
+void StocSynthEngine::prepare (double newSampleRate, int newMaxBlockSize, int newNumChannels)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    maxBlockSize = newMaxBlockSize > 0 ? newMaxBlockSize : 512;
+    numChannels = newNumChannels > 0 ? newNumChannels : 1;
+
+    gainBlocks.clear();
+    for (int channel = 0; channel < numChannels; ++channel) {
+        gainBlocks.push_back (std::make_unique<Gain_Block>());
+        gainBlocks.back()->prepare (maxBlockSize);
+    }
+
+    sTFT->setup (numChannels);
+    sTFT->updateFrameBatching (frameBatching, maxBlockSize);
+    prepareBandSplit();
+    prepared = true;
+    buildTiers();
+    allocateBypass();
+}
+
+void StocSynthEngine::release()
+{
+    prepared = false;
+    degradedTiers.clear();
+    transitionBuffers.clear();
+    transitionChannels.clear();
+    activeTier = 0;
+    fadingTier = -1;
+    qualityTier.store (0, std::memory_order_relaxed);
+}
+
+void StocSynthEngine::configure (int newFftSize, int newOverlap, int newWindowType)
+{
+    if (! isValidConfiguration (newFftSize, newOverlap, newWindowType))
+        return;
+
+    fftSize = newFftSize;
+    overlap = newOverlap;
+    windowType = newWindowType;
+    prepareBandSplit();
+    buildTiers();
+    allocateBypass();
+}
+
+void StocSynthEngine::applyPreset (int preset)
+{
+    if (preset < 0 || preset >= numPresets)
+        return;
+
+    const PresetSettings& settings = getPresetSettings (preset);
+    configure (settings.fftSize, settings.overlap, settings.windowType);
+}
+
+void StocSynthEngine::reset()
+{
+    sTFT->updateParameters (fftSize / bandSplitter.getFactor(), overlap, windowType);
+    sTFT->resetFrameCounters();
+    bandSplitter.reset();
+    clearTiers();
+    for (auto& gainBlock : gainBlocks)
+        gainBlock->prepare (maxBlockSize);
+    restartAtFullQuality();
+
+    for (auto& delay : dryDelay)
+        std::fill (delay.begin(), delay.end(), 0.0f);
+    dryPosition = 0;
+    wetRunning = ! bypassed;
+    bypassFade = bypassed ? bypassFadeLength : 0;
+    bypassWarmUp = 0;
+    primedSamples = 0;
+}
+
+void StocSynthEngine::clearTiers() noexcept
+{
+    for (Tier& tier : degradedTiers) {
+        tier.stft->clearState();
+        tier.stft->resetFrameCounters();
+        for (auto& delay : tier.delay)
+            std::fill (delay.begin(), delay.end(), 0.0f);
+        tier.delayPosition = 0;
+    }
+}
+
+void StocSynthEngine::restartAtFullQuality() noexcept
+{
+    getTierStft (activeTier).updateTelemetry (false);
+    if (fadingTier >= 0)
+        getTierStft (fadingTier).updateTelemetry (false);
+    sTFT->updateTelemetry (telemetryEnabled);
+    activeTier = 0;
+    fadingTier = -1;
+    governor.reset();
+    qualityTier.store (0, std::memory_order_relaxed);
+    cpuLoad.store (0.0f, std::memory_order_relaxed);
+}
+
+void StocSynthEngine::setSilenceThreshold (float newValue) noexcept
+{
+    silenceThreshold = newValue;
+    // the band split's low band is louder, see BandSplitter::split ()
+    const float threshold = newValue * bandSplitter.getFactor();
+    forEachStft ([threshold] (STFT& stft) { stft.updateSilenceThreshold (threshold); });
+}
+
+void StocSynthEngine::setBinPruning (bool shouldPrune) noexcept
+{
+    binPruning = shouldPrune;
+    sTFT->updateBinPruning (shouldPrune);
+    for (Tier& tier : degradedTiers)
+        tier.stft->updateBinPruning (shouldPrune || tier.settings.binPruning);
+}
+
+void StocSynthEngine::setQualityProfiles (const QualityProfile& realtime, const QualityProfile& offline) noexcept
+{
+    qualityProfiles[0] = realtime;
+    qualityProfiles[1] = offline;
+    hasQualityProfiles = true;
+}
+
+bool StocSynthEngine::setNonRealtime (bool shouldRenderOffline)
+{
+    nonRealtime = shouldRenderOffline;
+    const QualityProfile& profile = qualityProfiles[nonRealtime ? 1 : 0];
+    if (! hasQualityProfiles || ! isValidConfiguration (profile.fftSize, profile.overlap, profile.windowType)
+        || profile == getCurrentProfile())
+        return false;
+
+    if (profile.fftSize != fftSize || profile.overlap != overlap || profile.windowType != windowType)
+        configure (profile.fftSize, profile.overlap, profile.windowType);
+    setBinPruning (profile.binPruning);
+    return true;
+}
+
+void StocSynthEngine::setChannelLanes (bool shouldUseLanes)
+{
+    channelLanes = shouldUseLanes;
+    forEachStft ([shouldUseLanes] (STFT& stft) { stft.updateChannelLanes (shouldUseLanes); });
+}
+
+void StocSynthEngine::setSinusoids (int maxPartials, float thresholdDb)
+{
+    sinusoidPartials = maxPartials;
+    sinusoidThresholdDb = thresholdDb;
+    forEachStft ([maxPartials, thresholdDb] (STFT& stft) { stft.updateSinusoids (maxPartials, thresholdDb); });
+}
+
+void StocSynthEngine::setFilterBank (int numBands)
+{
+    filterBankBands = numBands;
+    forEachStft ([numBands] (STFT& stft) { stft.updateFilterBank (numBands); });
+    // the latency changes, and with it the dry path, the delays of the tiers and the band split's
+    if (bandSplitter.isActive())
+        prepareBandSplit();
+    buildTiers();
+    allocateBypass();
+}
+
+void StocSynthEngine::setPhasorPhases (bool shouldUsePhasors, float inputPhaseBias)
+{
+    phasorPhases = shouldUsePhasors;
+    phasorBias = inputPhaseBias;
+    forEachStft ([shouldUsePhasors, inputPhaseBias] (STFT& stft) { stft.updatePhasors (shouldUsePhasors, inputPhaseBias); });
+    // the level changes, see buildTiers ()
+    buildTiers();
+}
+
+void StocSynthEngine::setSlidingDft (bool shouldSlide)
+{
+    slidingDft = shouldSlide;
+    forEachStft ([shouldSlide] (STFT& stft) { stft.updateSlidingDft (shouldSlide); });
+}
+
+int StocSynthEngine::addSpectralNode (int type)
+{
+    if (type < 0 || type >= SpectralNode::numTypes)
+        return -1;
+
+    spectralNodes.push_back (SpectralNode::getDefaultSettings (type));
+    forEachStft ([this] (STFT& stft) { stft.updateSpectralNodes (spectralNodes.data(), (int)spectralNodes.size()); });
+    return (int)spectralNodes.size() - 1;
+}
+
+void StocSynthEngine::clearSpectralNodes()
+{
+    spectralNodes.clear();
+    forEachStft ([] (STFT& stft) { stft.updateSpectralNodes (nullptr, 0); });
+}
+
+void StocSynthEngine::setSpectralNodeParameter (int node, int parameter, float value) noexcept
+{
+    if (node < 0 || node >= (int)spectralNodes.size() || parameter < 0 || parameter >= SpectralNode::maxParameters)
+        return;
+    spectralNodes[(size_t)node].parameters[parameter] = value;
+}
+
+void StocSynthEngine::setEnvelopeDecimation (int interval, float fluxThreshold)
+{
+    envelopeInterval = interval;
+    envelopeFluxThreshold = fluxThreshold;
+    forEachStft ([interval, fluxThreshold] (STFT& stft) { stft.updateEnvelopeDecimation (interval, fluxThreshold); });
+    // the level changes, see buildTiers ()
+    buildTiers();
+}
+
+void StocSynthEngine::setBandSplit (float splitFrequency)
+{
+    bandSplitFrequency = splitFrequency > 0.0f ? splitFrequency : 0.0f;
+    prepareBandSplit();
+    buildTiers();
+    allocateBypass();
+}
+
+void StocSynthEngine::prepareBandSplit()
+{
+    // the FFT shrinks with the rate so the bins stay as wide, down to the smallest valid one
+    int numStages = BandSplitter::getNumStages (sampleRate, bandSplitFrequency);
+    while (numStages > 0 && ! isValidConfiguration (fftSize >> numStages, overlap, windowType))
+        --numStages;
+
+    sTFT->updateSampleRate (sampleRate / (1 << numStages));
+    sTFT->updateParameters (fftSize >> numStages, overlap, windowType);
+    bandSplitter.prepare (sampleRate, bandSplitFrequency, numStages, numChannels, maxBlockSize, sTFT->getLatencySamples());
+    sTFT->updateSilenceThreshold (silenceThreshold * bandSplitter.getFactor());
+}
+
+void StocSynthEngine::setTelemetryEnabled (bool shouldPublish) noexcept
+{
+    telemetryEnabled = shouldPublish;
+    // the tier fading in publishes once a transition has started
+    getTierStft (fadingTier >= 0 ? fadingTier : activeTier).updateTelemetry (shouldPublish);
+}
+
+uint64_t StocSynthEngine::getFrameCount() const noexcept
+{
+    uint64_t frames = sTFT->getFrameCount();
+    for (const Tier& tier : degradedTiers)
+        frames += tier.stft->getFrameCount();
+    return frames;
+}
+
+uint64_t StocSynthEngine::getSkippedFrameCount() const noexcept
+{
+    uint64_t frames = sTFT->getSkippedFrameCount();
+    for (const Tier& tier : degradedTiers)
+        frames += tier.stft->getSkippedFrameCount();
+    return frames;
+}
+
+uint64_t StocSynthEngine::getRepairedFrameCount() const noexcept
+{
+    uint64_t frames = sTFT->getRepairedFrameCount();
+    for (const Tier& tier : degradedTiers)
+        frames += tier.stft->getRepairedFrameCount();
+    return frames;
+}
+
+uint64_t StocSynthEngine::getRepairedValueCount() const noexcept
+{
+    uint64_t values = sTFT->getRepairedValueCount();
+    for (const Tier& tier : degradedTiers)
+        values += tier.stft->getRepairedValueCount();
+    return values;
+}
+
+void StocSynthEngine::setGovernor (bool shouldGovern)
+{
+    if (shouldGovern == governorEnabled)
+        return;
+    governorEnabled = shouldGovern;
+    buildTiers();
+}
+
+StocSynthEngine::TierSettings StocSynthEngine::getQualityTierSettings (int tier) const noexcept
+{
+    if (tier <= 0 || tier > (int)degradedTiers.size())
+        return { fftSize, overlap, binPruning };
+    return degradedTiers[(size_t)tier - 1].settings;
+}
+
+void StocSynthEngine::process (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    if (numBlockSamples <= 0)
+        return;
+    if (bypassed || bypassFade > 0 || ! wetRunning) {
+        processBypass (channels, numBlockChannels < numChannels ? numBlockChannels : numChannels, numBlockSamples, stride);
+        return;
+    }
+
+    delayDry (channels, numBlockChannels < numChannels ? numBlockChannels : numChannels, numBlockSamples, stride, false);
+    if (! governorEnabled) {
+        processUngoverned (channels, numBlockChannels, numBlockSamples, stride);
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    processUngoverned (channels, numBlockChannels, numBlockSamples, stride);
+    const double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+    // a transition costs both tiers, those blocks say nothing about either
+    if (fadingTier < 0) {
+        const int next = governor.update (elapsed, numBlockSamples);
+        if (next != activeTier)
+            beginTransition (next);
+        cpuLoad.store (governor.getLoad(), std::memory_order_relaxed);
+    }
+}
+
+void StocSynthEngine::processUngoverned (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    const int channelsToProcess = numBlockChannels < numChannels ? numBlockChannels : numChannels;
+    if (! bandSplitter.isActive()) {
+        renderWet (channels, channelsToProcess, numBlockSamples, stride);
+        return;
+    }
+
+    // only the low band goes through the tiers, in maxBlockSize pieces
+    for (int start = 0; start < numBlockSamples; start += maxBlockSize) {
+        const int length = std::min (maxBlockSize, numBlockSamples - start);
+        for (int channel = 0; channel < channelsToProcess; ++channel)
+            splitChannels[(size_t)channel] = channels[channel] + (size_t)start * stride;
+        const int numLowSamples = bandSplitter.split (splitChannels.data(), channelsToProcess, length, stride);
+        if (numLowSamples > 0)
+            renderWet (bandSplitter.getLowChannels(), channelsToProcess, numLowSamples, 1);
+        bandSplitter.merge (splitChannels.data(), channelsToProcess, length, stride);
+    }
+}
+
+void StocSynthEngine::renderWet (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    if (fadingTier >= 0)
+        renderTransition (channels, numBlockChannels, numBlockSamples, stride);
+    else
+        renderTier (activeTier, channels, numBlockChannels, numBlockSamples, stride);
+
+    for (int channel = 0; channel < numBlockChannels; ++channel) {
+        gainBlocks[channel]->setGain (amp * synthesisGain);
+        gainBlocks[channel]->process (channels[channel], numBlockSamples, stride);
+    }
+}
+
+void StocSynthEngine::renderOffline (float* const* channels, int numRenderChannels, int64_t numSamples, int numThreads)
+{
+    if (numSamples <= 0)
+        return;
+
+    const int channelsToRender = numRenderChannels < numChannels ? numRenderChannels : numChannels;
+    if (sinusoidPartials > 0 || filterBankBands > 0 || bandSplitter.isActive() || sTFT->isSlidingDftActive()
+        || sTFT->getEnvelopeDecimation() > 1) {
+        std::vector<float*> block ((size_t)channelsToRender);
+        reset();
+        for (int64_t start = 0; start < numSamples; start += maxBlockSize) {
+            for (int channel = 0; channel < channelsToRender; ++channel)
+                block[(size_t)channel] = channels[channel] + start;
+            processUngoverned (block.data(), channelsToRender, (int)std::min<int64_t> (maxBlockSize, numSamples - start), 1);
+        }
+        reset();
+        return;
+    }
+
+    auto renderer = makeOfflineRenderer (numThreads);
+    for (int channel = 0; channel < channelsToRender; ++channel) {
+        renderer->render (channels[channel], numSamples, (uint64_t)channel << 48);
+        applyOfflineGain (channels[channel], numSamples, amp * synthesisGain);
+    }
+
+    reset();
+}
+
+void StocSynthEngine::renderStretched (const float* const* input, float* const* output, int numRenderChannels,
+                                       int64_t numInputSamples, double stretch, int numThreads)
+{
+    stretch = std::min (maxStretch, std::max (minStretch, stretch));
+    const int64_t numOutputSamples = getStretchedLength (numInputSamples, stretch);
+    if (numOutputSamples <= 0)
+        return;
+
+    const int channelsToRender = numRenderChannels < numChannels ? numRenderChannels : numChannels;
+    auto renderer = makeOfflineRenderer (numThreads);
+    // at the level process () gives with the analysed phases
+    const float stretchGain = measureLevel (fftSize, overlap, false, 1) / measureStretchedLevel (*renderer, stretch);
+    for (int channel = 0; channel < channelsToRender; ++channel) {
+        // a different noise per channel, like separate analyses would give
+        renderer->renderStretched (input[channel], numInputSamples, output[channel], numOutputSamples,
+                                   stretch, (uint64_t)channel << 48);
+        applyOfflineGain (output[channel], numOutputSamples, amp * stretchGain);
+    }
+
+    reset();
+}
+
+//==============================================================================
+void StocSynthEngine::buildTiers()
+{
+    // the STFT has no frame layout before the first prepare (), which builds them
+    if (! prepared)
+        return;
+
+    // The inverse FFT keeps the analysed phases, so its frames add up partly in phase, more so the more
+    // they overlap. The filter bank assumes they do not, which is right at 4x and off by about 3 dB per
+    // doubling beyond it, and the phasors and the decimated envelope's random phases make sure they do not,
+    // so all of them are matched the same way as the tiers
+    const int factor = bandSplitter.getFactor();
+    const int frameSize = fftSize / factor;
+    synthesisGain = filterBankBands > 0 || phasorPhases || sTFT->getEnvelopeDecimation() > 1
+                  ? measureLevel (frameSize, overlap, false, factor) / measureLevel (frameSize, overlap, true, factor) : 1.0f;
+
+    degradedTiers.clear();
+    if (governorEnabled) {
+        // every step roughly halves the cost: half the frames, then half the bins, then the bins above LowCutoff gone
+        TierSettings settings { fftSize, overlap, false };
+        const float level = measureLevel (frameSize, overlap, true, factor);
+        for (int step = 0; step < maxDegradedTiers; ++step) {
+            if (step == 0 && settings.overlap >= 4)
+                settings.overlap /= 2;
+            else if (step == 1 && settings.fftSize >= 256 && isValidConfiguration (settings.fftSize / 2 / factor, settings.overlap, windowType))
+                settings.fftSize /= 2;
+            else if (step == 2)
+                settings.binPruning = true;
+            else
+                continue;
+
+            Tier tier;
+            tier.settings = settings;
+            tier.stft = std::make_unique<STFT>();
+            STFT& stft = *tier.stft;
+            stft.setup (numChannels);
+            stft.updateSampleRate (sampleRate / factor);
+            stft.updateFrameBatching (frameBatching, maxBlockSize);
+            stft.updateParameters (settings.fftSize / factor, settings.overlap, windowType);
+            stft.updateSilenceThreshold (silenceThreshold * factor);
+            stft.updateBinPruning (binPruning || settings.binPruning);
+            stft.updateChannelLanes (channelLanes);
+            stft.updateSinusoids (sinusoidPartials, sinusoidThresholdDb);
+            stft.updateFilterBank (filterBankBands);
+            stft.updatePhasors (phasorPhases, phasorBias);
+            stft.updateSlidingDft (slidingDft);
+            stft.updateSpectralNodes (spectralNodes.data(), (int)spectralNodes.size());
+            stft.updateEnvelopeDecimation (envelopeInterval, envelopeFluxThreshold);
+            stft.useSpectrumTap (sTFT->getSpectrumTap());
+            tier.delay.assign ((size_t)numChannels, std::vector<float> ((size_t)std::max (0, sTFT->getLatencySamples() - stft.getLatencySamples()), 0.0f));
+            // pruning drops the top band on purpose, only the frame layout changes the level
+            tier.gain = settings.binPruning && ! degradedTiers.empty() ? degradedTiers.back().gain
+                                                                        : level / measureLevel (settings.fftSize / factor, settings.overlap, true, factor);
+            degradedTiers.push_back (std::move (tier));
+        }
+    }
+
+    // equal power, the tiers' noise is uncorrelated
+    fadeLength = frameSize;
+    fadeCurve.resize ((size_t)fadeLength + 1);
+    for (int index = 0; index <= fadeLength; ++index)
+        fadeCurve[(size_t)index] = (float)std::sin (0.5 * M_PI * index / fadeLength);
+    transitionBuffers.assign (degradedTiers.empty() ? 0 : (size_t)numChannels, std::vector<float> ((size_t)maxBlockSize, 0.0f));
+    transitionChannels.assign (transitionBuffers.size(), nullptr);
+    for (size_t channel = 0; channel < transitionBuffers.size(); ++channel)
+        transitionChannels[channel] = transitionBuffers[channel].data();
+    blockChannels.assign ((size_t)numChannels, nullptr);
+    splitChannels.assign ((size_t)numChannels, nullptr);
+
+    activeTier = 0;
+    fadingTier = -1;
+    sTFT->updateTelemetry (telemetryEnabled);
+    governor.prepare (sampleRate, getNumQualityTiers());
+    qualityTier.store (0, std::memory_order_relaxed);
+    cpuLoad.store (0.0f, std::memory_order_relaxed);
+}
+
+namespace
+{
+    // the white noise the levels are measured on, uniform in -1 .. 1
+    float nextReferenceSample (uint32_t& seed) noexcept
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / 8388608.0f - 1.0f;
+    }
+}
+
+float StocSynthEngine::measureLevel (int frameSize, int frameOverlap, bool configured, int rateFactor) const
+{
+    const LevelKey key { sampleRate, fftSize, frameSize, frameOverlap, rateFactor, windowType, stochFactor, noiseLevel, lowCutoff,
+                         configured ? filterBankBands : 0, configured ? envelopeInterval : 1,
+                         configured && phasorPhases, configured ? phasorBias : 0.0f, configured ? envelopeFluxThreshold : 0.0f };
+    for (const auto& measured : measuredLevels)
+        if (measured.first == key)
+            return measured.second;
+
+    // The resynthesis level depends on the frame layout, by about 2 dB per halving. Measured on
+    // the same white noise with the current settings, 16 frames (or 32768 samples) after two of warm-up.
+    // On the heap, hosts prepare on threads with small stacks
+    auto measuring = std::make_unique<STFT>();
+    STFT& stft = *measuring;
+    stft.setup (1);
+    stft.updateSampleRate (sampleRate / rateFactor);
+    stft.updateParameters (frameSize, frameOverlap, windowType);
+    if (configured) {
+        stft.updateFilterBank (filterBankBands);
+        stft.updatePhasors (phasorPhases, phasorBias);
+        stft.updateEnvelopeDecimation (envelopeInterval, envelopeFluxThreshold);
+    }
+    stft.updateStochfactor (stochFactor);
+    stft.updatedecimation (noiseLevel);
+    stft.updatecutoff (lowCutoff);
+
+    const int configuredSize = fftSize / rateFactor;
+    const int warmUp = 2 * configuredSize, length = std::max (16 * configuredSize, 32768);
+    // white noise band limited by the band split is louder by the root of its factor, see BandSplitter::split ()
+    const float amplitude = 0.05f * std::sqrt ((float)rateFactor);
+    std::vector<float> block ((size_t)maxBlockSize);
+    float* channels[] { block.data() };
+    uint32_t seed = 0x2545f491u;
+    double sum = 0.0;
+    for (int start = 0; start < warmUp + length; start += maxBlockSize) {
+        const int count = std::min (maxBlockSize, warmUp + length - start);
+        for (int sample = 0; sample < count; ++sample)
+            block[(size_t)sample] = amplitude * nextReferenceSample (seed);
+        stft.processBlock (channels, 1, count, 1);
+        for (int sample = std::max (0, warmUp - start); sample < count; ++sample)
+            sum += (double)block[(size_t)sample] * block[(size_t)sample];
+    }
+
+    const float level = (float)std::sqrt (sum / length + 1.0e-30);
+    if (measuredLevels.size() >= maxMeasuredLevels)
+        measuredLevels.clear();
+    measuredLevels.emplace_back (key, level);
+    return level;
+}
+
+float StocSynthEngine::measureStretchedLevel (OfflineRenderer& renderer, double stretch) const
+{
+    // renderStretched () draws new phases for every frame and interpolates the envelopes between
+    // analyses, so its level moves with the stretch as well as with the frame layout. Measured on
+    // measureLevel ()'s noise at the full rate, away from both ends
+    const int warmUp = 2 * fftSize, length = std::max (16 * fftSize, 32768);
+    std::vector<float> input ((size_t)(warmUp + length + 2 * fftSize));
+    uint32_t seed = 0x2545f491u;
+    for (float& sample : input)
+        sample = 0.05f * nextReferenceSample (seed);
+
+    std::vector<float> output ((size_t)getStretchedLength ((int64_t)input.size(), stretch));
+    renderer.renderStretched (input.data(), (int64_t)input.size(), output.data(), (int64_t)output.size(), stretch, 0);
+    const size_t first = (size_t)std::llround (warmUp * stretch), last = (size_t)std::llround ((warmUp + length) * stretch);
+    double sum = 0.0;
+    for (size_t sample = first; sample < last; ++sample)
+        sum += (double)output[sample] * output[sample];
+    return (float)std::sqrt (sum / (double)(last - first) + 1.0e-30);
+}
+
+void StocSynthEngine::renderTier (int tier, float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    STFT& stft = getTierStft (tier);
+    stft.updateStochfactor (stochFactor);
+    stft.updatedecimation (noiseLevel);
+    stft.updatecutoff (lowCutoff);
+    stft.updateSpectralNodeParameters (spectralNodes.data(), (int)spectralNodes.size());
+    stft.processBlock (channels, numBlockChannels, numBlockSamples, stride);
+    if (tier == 0)
+        return;
+
+    // at the level of the configuration and up to its latency
+    Tier& state = degradedTiers[(size_t)tier - 1];
+    const int length = (int)state.delay.front().size();
+    for (int channel = 0; channel < numBlockChannels; ++channel) {
+        float* data = channels[channel];
+        for (int sample = 0; sample < numBlockSamples; ++sample)
+            data[(size_t)sample * stride] *= state.gain;
+        if (length == 0)
+            continue;
+
+        float* ring = state.delay[(size_t)channel].data();
+        int position = state.delayPosition;
+        for (int sample = 0; sample < numBlockSamples; ++sample) {
+            std::swap (ring[position], data[(size_t)sample * stride]);
+            if (++position >= length)
+                position = 0;
+        }
+    }
+    if (length == 0)
+        return;
+    state.delayPosition = (int)((state.delayPosition + (int64_t)numBlockSamples) % length);
+}
+
+void StocSynthEngine::beginTransition (int tier) noexcept
+{
+    STFT& stft = getTierStft (tier);
+    stft.clearState();
+    if (tier > 0) {
+        Tier& state = degradedTiers[(size_t)tier - 1];
+        for (auto& delay : state.delay)
+            std::fill (delay.begin(), delay.end(), 0.0f);
+        state.delayPosition = 0;
+    }
+
+    // its output is only complete once every frame overlapping it had input: one frame, plus the latency
+    getTierStft (activeTier).updateTelemetry (false);
+    stft.updateTelemetry (telemetryEnabled);
+    fadingTier = tier;
+    transitionPosition = 0;
+    warmUpLength = (fftSize + getQualityTierSettings (tier).fftSize) / bandSplitter.getFactor();
+    qualityTier.store (tier, std::memory_order_relaxed);
+}
+
+void StocSynthEngine::renderTransition (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    // both tiers in maxBlockSize pieces, the one fading in on a copy of the input
+    for (int start = 0; start < numBlockSamples;) {
+        for (int channel = 0; channel < numBlockChannels; ++channel)
+            blockChannels[(size_t)channel] = channels[channel] + (size_t)start * stride;
+        if (fadingTier < 0) {
+            renderTier (activeTier, blockChannels.data(), numBlockChannels, numBlockSamples - start, stride);
+            return;
+        }
+
+        const int length = std::min (maxBlockSize, numBlockSamples - start);
+        for (int channel = 0; channel < numBlockChannels; ++channel)
+            for (int sample = 0; sample < length; ++sample)
+                transitionChannels[(size_t)channel][sample] = blockChannels[(size_t)channel][(size_t)sample * stride];
+
+        renderTier (activeTier, blockChannels.data(), numBlockChannels, length, stride);
+        renderTier (fadingTier, transitionChannels.data(), numBlockChannels, length, 1);
+
+        for (int channel = 0; channel < numBlockChannels; ++channel) {
+            float* data = blockChannels[(size_t)channel];
+            const float* incoming = transitionChannels[(size_t)channel];
+            for (int sample = 0; sample < length; ++sample) {
+                const int fade = std::min (fadeLength, std::max (0, transitionPosition + sample - warmUpLength));
+                float& output = data[(size_t)sample * stride];
+                output = output * fadeCurve[(size_t)(fadeLength - fade)] + incoming[sample] * fadeCurve[(size_t)fade];
+            }
+        }
+
+        start += length;
+        if ((transitionPosition += length) >= warmUpLength + fadeLength) {
+            getTierStft (activeTier).updateTelemetry (false);
+            activeTier = fadingTier;
+            fadingTier = -1;
+        }
+    }
+}
+
+void StocSynthEngine::allocateBypass()
+{
+    dryDelay.assign ((size_t)numChannels, std::vector<float> ((size_t)getLatencySamples(), 0.0f));
+    dryPosition = 0;
+    wetBuffers.assign ((size_t)numChannels, std::vector<float> ((size_t)maxBlockSize, 0.0f));
+    wetChannels.assign ((size_t)numChannels, nullptr);
+    for (size_t channel = 0; channel < wetBuffers.size(); ++channel)
+        wetChannels[channel] = wetBuffers[channel].data();
+    dryChannels.assign ((size_t)numChannels, nullptr);
+
+    // equal power, the dry input and the resynthesised noise are uncorrelated
+    bypassFadeLength = std::max (1, (int)std::lround (bypassFadeSeconds * sampleRate));
+    bypassCurve.resize ((size_t)bypassFadeLength + 1);
+    for (int index = 0; index <= bypassFadeLength; ++index)
+        bypassCurve[(size_t)index] = (float)std::sin (0.5 * M_PI * index / bypassFadeLength);
+
+    // the STFT has just been cleared
+    wetRunning = ! bypassed;
+    bypassFade = bypassed ? bypassFadeLength : 0;
+    bypassWarmUp = 0;
+    primedSamples = 0;
+}
+
+void StocSynthEngine::processBypass (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept
+{
+    if (bypassed && bypassFade == bypassFadeLength) {
+        // fully bypassed, the output ring starts from silence when the wet path comes back
+        if (wetRunning) {
+            sTFT->clearState();
+            wetRunning = false;
+            primedSamples = 0;
+        }
+        // the band split starts over instead, its filters only run with the wet path
+        if (! bandSplitter.isActive()) {
+            sTFT->primeInput (channels, numBlockChannels, numBlockSamples, stride);
+            primedSamples = (int)std::min<int64_t> (fftSize, (int64_t)primedSamples + numBlockSamples);
+        }
+        delayDry (channels, numBlockChannels, numBlockSamples, stride, true);
+        return;
+    }
+
+    if (! wetRunning) {
+        // Output n overlaps the frames ending from n - fftSize on: they all have to have been
+        // transformed after the restart, on a ring that was filled before them
+        restartAtFullQuality();
+        bandSplitter.reset();
+        wetRunning = true;
+        bypassWarmUp = 2 * fftSize + bandSplitter.getLatencySamples() - primedSamples;
+    }
+
+    // the wet path on a copy, both in maxBlockSize pieces
+    for (int start = 0; start < numBlockSamples;) {
+        const int length = std::min (maxBlockSize, numBlockSamples - start);
+        for (int channel = 0; channel < numBlockChannels; ++channel) {
+            dryChannels[(size_t)channel] = channels[channel] + (size_t)start * stride;
+            for (int sample = 0; sample < length; ++sample)
+                wetChannels[(size_t)channel][sample] = dryChannels[(size_t)channel][(size_t)sample * stride];
+        }
+        processUngoverned (wetChannels.data(), numBlockChannels, length, 1);
+        delayDry (dryChannels.data(), numBlockChannels, length, stride, true);
+
+        int fade = bypassFade, warmUp = bypassWarmUp;
+        for (int channel = 0; channel < numBlockChannels; ++channel) {
+            float* data = dryChannels[(size_t)channel];
+            const float* wet = wetChannels[(size_t)channel];
+            fade = bypassFade;
+            warmUp = bypassWarmUp;
+            for (int sample = 0; sample < length; ++sample) {
+                float& output = data[(size_t)sample * stride];
+                output = wet[sample] * bypassCurve[(size_t)(bypassFadeLength - fade)] + output * bypassCurve[(size_t)fade];
+                if (bypassed)
+                    fade = std::min (bypassFadeLength, fade + 1);
+                else if (warmUp > 0)
+                    --warmUp;
+                else
+                    fade = std::max (0, fade - 1);
+            }
+        }
+        bypassFade = fade;
+        bypassWarmUp = warmUp;
+        start += length;
+    }
+}
+
+void StocSynthEngine::delayDry (float* const* channels, int numBlockChannels, int numBlockSamples, int stride, bool replace) noexcept
+{
+    const int length = getLatencySamples();
+    if (length == 0)
+        return;
+    for (int channel = 0; channel < numBlockChannels; ++channel) {
+        float* ring = dryDelay[(size_t)channel].data();
+        float* data = channels[channel];
+        int position = dryPosition;
+        for (int sample = 0; sample < numBlockSamples; ++sample) {
+            if (replace)
+                std::swap (ring[position], data[(size_t)sample * stride]);
+            else
+                ring[position] = data[(size_t)sample * stride];
+            if (++position >= length)
+                position = 0;
+        }
+    }
+    dryPosition = (int)((dryPosition + (int64_t)numBlockSamples) % length);
+}
+
+namespace
+{
+    // "SSst" and the layout of what follows, bump it whenever that changes
+    constexpr uint32_t stateMagic = 0x74735353u;
+    constexpr uint32_t stateVersion = 4;
+}
+
+std::vector<uint8_t> StocSynthEngine::saveState() const
+{
+    std::vector<uint8_t> data;
+    StateWriter writer (data);
+    writer.write (stateMagic);
+    writer.write (stateVersion);
+    writer.write (sampleRate);
+    writer.write (maxBlockSize);
+    writer.write (windowType);
+    writer.write (sinusoidPartials);
+    writer.write (filterBankBands);
+    writer.write (bandSplitter.getFactor());
+    sTFT->saveState (writer);
+    bandSplitter.saveState (writer);
+
+    for (const auto& gainBlock : gainBlocks)
+        writer.write (gainBlock->getRampGain());
+    writer.write (wetRunning);
+    writer.write (bypassFade);
+    writer.write (bypassWarmUp);
+    writer.write (primedSamples);
+    for (const auto& delay : dryDelay)
+        writer.write (delay);
+    writer.write (dryPosition);
+    return data;
+}
+
+bool StocSynthEngine::loadState (const void* data, size_t size)
+{
+    StateReader reader (data, size);
+    reader.expect (stateMagic);
+    reader.expect (stateVersion);
+    reader.expect (sampleRate);
+    reader.expect (maxBlockSize);
+    reader.expect (windowType);
+    reader.expect (sinusoidPartials);
+    reader.expect (filterBankBands);
+    reader.expect (bandSplitter.getFactor());
+    sTFT->loadState (reader);
+    bandSplitter.loadState (reader);
+
+    for (auto& gainBlock : gainBlocks) {
+        float rampGain = 0.0f;
+        reader.read (rampGain);
+        gainBlock->setRampGain (rampGain);
+    }
+    reader.read (wetRunning);
+    reader.read (bypassFade);
+    reader.read (bypassWarmUp);
+    reader.read (primedSamples);
+    for (auto& delay : dryDelay)
+        reader.read (delay);
+    reader.read (dryPosition);
+
+    if (! reader.isAtEnd()) {
+        // half of it may have gone in already
+        reset();
+        return false;
+    }
+    clearTiers();
+    restartAtFullQuality();
+    return true;
+}
+
+int64_t StocSynthEngine::getPreRollStart (int64_t position) const noexcept
+{
+    // the output from position on overlaps the frames ending up to one frame before it, and those read
+    // one more frame of input, the band split's filters up to twice their delay on top. From a hop boundary,
+    // so the frames fall where they fell from sample 0 (and the decimation on the same samples). The sliding
+    // DFT only gives the same spectra after it has started over from the ring, which it does once a frame.
+    // A decimated envelope ramps from whatever played before the first analysis with a full ring, and is
+    // only exact again from the analysis after it
+    const int hopSize = fftSize / overlap;
+    const int frames = sTFT->isSlidingDftActive() ? 3 : 2;
+    const int64_t decimation = sTFT->getEnvelopeDecimation() > 1 ? 2 * (int64_t)sTFT->getEnvelopeDecimation() * hopSize : 0;
+    const int64_t start = position - frames * (int64_t)fftSize - decimation - 2 * (int64_t)bandSplitter.getLatencySamples();
+    return start > 0 ? start / hopSize * hopSize : 0;
+}
+
+void StocSynthEngine::seek (int64_t position, const float* const* preRoll, int numPreRollChannels)
+{
+    reset();
+    const int64_t start = getPreRollStart (position);
+    sTFT->setHopCount ((uint64_t)(start / (fftSize / overlap)));
+    // the fade in after a reset is long over at any later block boundary
+    if (position > 0)
+        for (auto& gainBlock : gainBlocks)
+            gainBlock->setRampGain (amp * synthesisGain);
+
+    const int channelsToProcess = numPreRollChannels < numChannels ? numPreRollChannels : numChannels;
+    std::vector<std::vector<float>> buffers ((size_t)channelsToProcess, std::vector<float> ((size_t)maxBlockSize));
+    std::vector<float*> block ((size_t)channelsToProcess);
+    for (int64_t done = 0; done < position - start;) {
+        const int length = (int)std::min<int64_t> (maxBlockSize, position - start - done);
+        for (int channel = 0; channel < channelsToProcess; ++channel) {
+            std::copy (preRoll[channel] + done, preRoll[channel] + done + length, buffers[(size_t)channel].begin());
+            block[(size_t)channel] = buffers[(size_t)channel].data();
+        }
+        process (block.data(), channelsToProcess, length);
+        done += length;
+    }
+}
+
+int64_t StocSynthEngine::getStretchedLength (int64_t numInputSamples, double stretch) noexcept
+{
+    stretch = std::min (maxStretch, std::max (minStretch, stretch));
+    return numInputSamples > 0 ? (int64_t)std::llround ((double)numInputSamples * stretch) : 0;
+}
+
+std::unique_ptr<OfflineRenderer> StocSynthEngine::makeOfflineRenderer (int numThreads) const
+{
+    return std::make_unique<OfflineRenderer> ([this] (STFT& worker) {
+        worker.updateSampleRate (sampleRate);
+        worker.updateParameters (fftSize, overlap, windowType);
+        worker.updateStochfactor (stochFactor);
+        worker.updatedecimation (noiseLevel);
+        worker.updatecutoff (lowCutoff);
+        worker.updateSilenceThreshold (silenceThreshold);
+        worker.updateBinPruning (binPruning);
+        worker.updatePhasors (phasorPhases, phasorBias);
+        worker.updateSpectralNodes (spectralNodes.data(), (int)spectralNodes.size());
+    }, numThreads);
+}
+
+void StocSynthEngine::applyOfflineGain (float* data, int64_t numSamples, float gainValue) const
+{
+    // the gain ramps over the first block after a reset, so it goes block by block like process ()
+    Gain_Block gain;
+    gain.prepare (maxBlockSize);
+    gain.setGain (gainValue);
+    for (int64_t start = 0; start < numSamples; start += maxBlockSize)
+        gain.process (data + start, (int)std::min<int64_t> (maxBlockSize, numSamples - start));
+}
+
+bool StocSynthEngine::isValidConfiguration (int fftSize, int overlap, int windowType) noexcept
+{
+    // the output ring wraps in whole hops, so the overlap has to divide fftSize
+    auto isPowerOfTwo = [] (int x) { return x > 0 && (x & (x - 1)) == 0; };
+    return isPowerOfTwo (fftSize) && fftSize >= 64 && fftSize <= 16384
+        && isPowerOfTwo (overlap) && overlap <= fftSize
+        && windowType >= STFT::windowTypeRectangular && windowType <= STFT::windowTypeHamming;
+}
+
+const StocSynthEngine::PresetSettings& StocSynthEngine::getPresetSettings (int preset) noexcept
+{
+    static const PresetSettings presets[numPresets] {
+        { "tracking", 256,  2, STFT::windowTypeHann },
+        { "mix",      2048, 4, STFT::windowTypeHann },
+        { "render",   8192, 8, STFT::windowTypeHann }
+    };
+    return presets[preset >= 0 && preset < numPresets ? preset : presetMix];
+}
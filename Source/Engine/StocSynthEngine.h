@@ -0,0 +1,407 @@
+/*
+  ==============================================================================
+
+    StocSynthEngine.h
+    Created: 2 Apr 2023 5:03:41pm
+    Author:  Onez
+
+    Everything the plugin does to a block, without any JUCE types:
+    STFT stochastic resynthesis followed by the output gain. With the
+    governor on, cheaper copies of the STFT stand by and take over, with a
+    crossfade, when the blocks take too long (see CpuGovernor).
+    The plugin processor and the C API (stocsynth.h) both drive this class.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "BandSplitter.h"
+#include "CpuGovernor.h"
+#include "STFT.h"
+#include "gain_block.h"
+
+class OfflineRenderer;
+
+class StocSynthEngine
+{
+public:
+    // latency / CPU trade-offs, the README lists what each one costs (stocsynth_bench)
+    enum Preset {
+        presetTracking = 0,
+        presetMix,
+        presetRender,
+        numPresets
+    };
+
+    struct PresetSettings
+    {
+        const char* name;
+        int fftSize;
+        int overlap;
+        int windowType;
+    };
+
+    // what a render mode runs, see setQualityProfiles ()
+    struct QualityProfile
+    {
+        int fftSize;
+        int overlap;
+        int windowType;
+        bool binPruning;
+
+        bool operator== (const QualityProfile& other) const noexcept
+        {
+            return fftSize == other.fftSize && overlap == other.overlap && windowType == other.windowType && binPruning == other.binPruning;
+        }
+        bool operator!= (const QualityProfile& other) const noexcept { return ! operator== (other); }
+    };
+
+    // what a quality tier runs, tier 0 is the configuration itself
+    struct TierSettings
+    {
+        int fftSize;
+        int overlap;
+        bool binPruning;
+    };
+
+    //======================================
+
+    StocSynthEngine();
+    ~StocSynthEngine();
+
+    // allocates everything, call before process () and whenever the layout changes. The setters may run
+    // before it, the governor's tiers and the level matching wait for it
+    void prepare (double newSampleRate, int newMaxBlockSize, int newNumChannels);
+    // Frees the governor's tiers. Until the next prepare () the setters only take note, so a host's
+    // prepare can set everything and build the tiers once. No process () in between
+    void release();
+    // fftSize: power of two in 64..16384, overlap: power of two <= fftSize. Invalid values are ignored
+    void configure (int newFftSize, int newOverlap, int newWindowType);
+    // configure () with one of the presets, out of range values are ignored
+    void applyPreset (int preset);
+    void reset();
+
+    void setStochFactor (float newValue) noexcept  { stochFactor = newValue; }
+    void setNoiseLevel (float newValue) noexcept   { noiseLevel = newValue; }
+    void setAmp (float newValue) noexcept          { amp = newValue; }
+    void setLowCutoff (float newValue) noexcept    { lowCutoff = newValue; }
+    void setSilenceThreshold (float newValue) noexcept;
+    // resynthesise only the band below LowCutoff, see STFT::updateBinPruning ()
+    void setBinPruning (bool shouldPrune) noexcept;
+
+    // One profile for real-time playback and one for offline renders (bounces), e.g. a cheap one while
+    // tracking and the biggest FFT for the bounce. setNonRealtime () runs the one for the mode, through
+    // configure () and setBinPruning (), and leaves the engine alone if that is what runs already. It
+    // returns true when it changed something, the latency may have moved then. Until the first
+    // setQualityProfiles () it only takes note of the mode. Invalid profiles are ignored. The envelope
+    // has one value per bin, so the FFT size is its resolution as well. Allocates like configure ()
+    void setQualityProfiles (const QualityProfile& realtime, const QualityProfile& offline) noexcept;
+    bool setNonRealtime (bool shouldRenderOffline);
+    bool isNonRealtime() const noexcept                          { return nonRealtime; }
+    QualityProfile getQualityProfile (bool offline) const noexcept { return qualityProfiles[offline ? 1 : 0]; }
+    QualityProfile getCurrentProfile() const noexcept            { return { fftSize, overlap, windowType, binPruning }; }
+
+    // transform all the frames of a block together when it holds several hops, same output (on by default).
+    // Takes effect at the next prepare ()
+    void setFrameBatching (bool shouldBatch) noexcept  { frameBatching = shouldBatch; }
+
+    // Run all channels side by side in vector lanes with approximate math (see STFT::updateChannelLanes ()),
+    // for multichannel stems. Off by default. Allocates, so not from the audio thread
+    void setChannelLanes (bool shouldUseLanes);
+
+    // Track up to maxPartials sinusoids (0 = off, the default) louder than thresholdDb and play them with an
+    // oscillator bank next to the stochastic residual, see STFT::updateSinusoids (). Allocates like the above
+    void setSinusoids (int maxPartials, float thresholdDb = -70.0f);
+
+    // Synthesise the stochastic part with numBands (4 .. 64) filtered noise bands instead of an inverse
+    // FFT per hop, 0 = off (the default). See STFT::updateFilterBank (): the frames are still analysed,
+    // but the latency drops to 0 and the synthesis cost no longer depends on the FFT size. Sinusoids are
+    // off while it is on. Allocates like the above
+    void setFilterBank (int numBands);
+
+    // Random phases from a table of unit phasors instead of the analysed ones, see STFT::updatePhasors ():
+    // no atan2, cos or sin per bin. inputPhaseBias (0 .. 1) pulls them towards the input's phases. The output
+    // is matched to the level of the analysed phases. Off by default. Allocates like the above
+    void setPhasorPhases (bool shouldUsePhasors, float inputPhaseBias = 0.0f);
+
+    // High overlap mode for hops of 8 .. 32 samples (overlap = fftSize / hop): a sliding DFT keeps the
+    // analysed bins up to date sample by sample instead of a forward FFT per hop, see STFT::updateSlidingDft ().
+    // Pays off with bin pruning, when only the band below LowCutoff is analysed. Hann, Hamming and the
+    // rectangular window only, Bartlett keeps the FFT. Off by default. Allocates like the above
+    void setSlidingDft (bool shouldSlide);
+    bool isSlidingDftEnabled() const noexcept  { return slidingDft; }
+
+    // Spectral effects on the same frames as the stochastic resynthesis, after it and before its inverse FFT,
+    // so a chain of them adds no transform and no latency, see SpectralNode. addSpectralNode () appends a
+    // SpectralNode::Type with its default parameters and returns its index, -1 for an unknown type. The
+    // filter bank has no inverse FFT and plays without them. They turn frame batching and channel lanes off.
+    // Both allocate, so not from the audio thread
+    int addSpectralNode (int type);
+    void clearSpectralNodes();
+    int getNumSpectralNodes() const noexcept   { return (int)spectralNodes.size(); }
+    // one of the node type's parameters (SpectralGate::Parameter, SpectralTilt::Parameter), out of range
+    // nodes and parameters are ignored. Safe from the audio thread
+    void setSpectralNodeParameter (int node, int parameter, float value) noexcept;
+
+    // Temporal envelope decimation for pads and ambiences: analyse only every interval hops (2 .. 16, 1 = off,
+    // the default) and ramp the envelope in between, with new random phases every hop, see
+    // STFT::updateEnvelopeDecimation (). fluxThreshold > 0 also analyses any hop whose band levels, from a
+    // frame an eighth as long, moved by more than that share since the last analysis (0.5 is a start). Not
+    // with the sinusoids, the filter bank or the sliding DFT. The level is matched to the analysed phases.
+    // Allocates, so not from the audio thread
+    void setEnvelopeDecimation (int interval, float fluxThreshold = 0.0f);
+    int getEnvelopeDecimation() const noexcept { return sTFT->getEnvelopeDecimation(); }
+
+    // Multirate band split, 0 = off (the default). A cascade of half-band filters (see BandSplitter) splits
+    // the input at splitFrequency and only the band below it goes through the STFT, decimated by the largest
+    // power of two that keeps splitFrequency under 0.4 of the decimated rate, with an FFT that many times
+    // smaller: the same bins for a fraction of the cost. Everything above comes out dry, at unity gain. The
+    // latency grows by the filters' delay. Set it at or above LowCutoff. Allocates like the above
+    void setBandSplit (float splitFrequency);
+    float getBandSplit() const noexcept        { return bandSplitFrequency; }
+    // how many times lower the STFT's rate is than the host's, 1 without the band split
+    int getBandSplitFactor() const noexcept    { return bandSplitter.getFactor(); }
+
+    // CPU governor, off by default. Up to three cheaper tiers (half the overlap, then half the FFT size,
+    // then bin pruning) are built next to the configured STFT, and process () steps through them when
+    // its blocks take more than stepDownLoad of their real-time length, and back once they take less
+    // than stepUpLoad for a while. The latency stays the configured one (smaller FFTs are delayed to
+    // match), their output is scaled to the configured level, and every step crossfades over a frame,
+    // after the new tier has filled its rings.
+    // Allocates, so not from the audio thread
+    void setGovernor (bool shouldGovern);
+    void setGovernorThresholds (float stepDownLoad, float stepUpLoad) noexcept { governor.setThresholds (stepDownLoad, stepUpLoad); }
+    bool isGovernorEnabled() const noexcept { return governorEnabled; }
+    // 0 is full quality. Written by the audio thread, safe to read from any other
+    int getQualityTier() const noexcept     { return qualityTier.load (std::memory_order_relaxed); }
+    int getNumQualityTiers() const noexcept { return 1 + (int)degradedTiers.size(); }
+    TierSettings getQualityTierSettings (int tier) const noexcept;
+    // averaged share of the real-time budget process () takes, only measured with the governor on
+    float getCpuLoad() const noexcept       { return cpuLoad.load (std::memory_order_relaxed); }
+
+    // Host bypass: the input comes out dry, delayed by the latency, after a short equal-power crossfade.
+    // Once fully bypassed no frame is transformed, the STFT only keeps its input ring filled (see
+    // STFT::primeInput ()), so coming back only waits for the frames overlapping the output to be
+    // complete again before fading the wet signal in, at full quality. Safe from the audio thread
+    void setBypassed (bool shouldBypass) noexcept  { bypassed = shouldBypass; }
+    bool isBypassed() const noexcept               { return bypassed; }
+    static constexpr double bypassFadeSeconds = 0.01;
+
+    // in place, channels[channel][sample * stride]
+    void process (float* const* channels, int numBlockChannels, int numBlockSamples, int stride = 1) noexcept;
+
+    // A whole file in place, with the frames spread over numThreads threads (<= 0: one per core).
+    // Bit-identical to reset () and then process () over the file in maxBlockSize blocks with channel
+    // lanes off and no bypass, and leaves the engine reset. The partials are tracked in order, so with sinusoids
+    // (or the filter bank, the band split, the sliding DFT or envelope decimation) on it is exactly that, on this thread. Allocates and starts threads, so not for the audio thread
+    void renderOffline (float* const* channels, int numRenderChannels, int64_t numSamples, int numThreads = 0);
+
+    // Time stretch of the stochastic component by 0.25 .. 4 (clamped), see OfflineRenderer::renderStretched ().
+    // output[channel] needs getStretchedLength () samples. Same threads, gain and reset as renderOffline ().
+    // Only the stochastic part through the inverse FFT at the full rate, the sinusoids, the filter bank and
+    // the band split are left out
+    void renderStretched (const float* const* input, float* const* output, int numRenderChannels,
+                          int64_t numInputSamples, double stretch, int numThreads = 0);
+    static int64_t getStretchedLength (int64_t numInputSamples, double stretch) noexcept;
+    static constexpr double minStretch = 0.25;
+    static constexpr double maxStretch = 4.0;
+
+    // Checkpoints for renders split into chunks. saveState () is everything process () carries from one
+    // block to the next (rings and positions, the gain ramp, the bypass fade and dry delay, partials and
+    // filter banks) as a compact blob, see StateBlob.h. loadState () puts it into an engine prepared and
+    // configured the same way, and its next process () carries on exactly like the saving engine's would.
+    // Parameters are not part of it, and the governor restarts at full quality. False (and a reset ()) if
+    // the blob does not fit this engine. Neither is for the audio thread
+    std::vector<uint8_t> saveState() const;
+    bool loadState (const void* data, size_t size);
+
+    // Seeking without a checkpoint: seek () resets and plays preRoll, the input from getPreRollStart (position)
+    // up to position, and from then on process () gives bit for bit what an engine that processed the whole
+    // input from sample 0 (same parameters, governor and bypass off) gives from position on, if position is on
+    // one of its block boundaries. Exact for the inverse FFT, phasors, sliding DFT and envelope decimation
+    // included (the sliding DFT needs a frame more of pre-roll, the decimation two intervals of hops). The filter bank's filters and
+    // the partials' oscillators remember further back than any pre-roll, with those on the output only
+    // settles to it: chain saveState () across the chunks instead. Allocates, so not for the audio thread
+    int64_t getPreRollStart (int64_t position) const noexcept;
+    void seek (int64_t position, const float* const* preRoll, int numPreRollChannels);
+
+    static bool isValidConfiguration (int fftSize, int overlap, int windowType) noexcept;
+    static const PresetSettings& getPresetSettings (int preset) noexcept;
+
+    // Output sample n comes from the frame that ended on input sample n - fftSize,
+    // so the delay is exactly one frame whatever the overlap. 0 with the filter bank.
+    // The band split's filters add their own
+    int getLatencySamples() const noexcept { return sTFT->getLatencySamples() * bandSplitter.getFactor() + bandSplitter.getLatencySamples(); }
+    // the last frame holding an input sample ends up to one frame later and plays for one more
+    int getTailSamples() const noexcept    { return 2 * fftSize + bandSplitter.getLatencySamples(); }
+
+    int getNumChannels() const noexcept    { return numChannels; }
+    int getMaxBlockSize() const noexcept   { return maxBlockSize; }
+    double getSampleRate() const noexcept  { return sampleRate; }
+    int getFftSize() const noexcept        { return fftSize; }
+    int getOverlap() const noexcept        { return overlap; }
+    int getWindowType() const noexcept     { return windowType; }
+
+    // STFT frames seen / skipped as silent since the last reset, over all tiers (thread safe)
+    uint64_t getFrameCount() const noexcept;
+    uint64_t getSkippedFrameCount() const noexcept;
+    // frames that had NaN, Inf, denormals or log10 (0) repaired in them, and how many values (thread safe)
+    uint64_t getRepairedFrameCount() const noexcept;
+    uint64_t getRepairedValueCount() const noexcept;
+
+    // per-hop snapshots of channel 0 from the tier playing, off by default
+    void setTelemetryEnabled (bool shouldPublish) noexcept;
+    SpectrumTap& getSpectrumTap() noexcept                 { return sTFT->getSpectrumTap(); }
+
+private:
+    struct Tier
+    {
+        std::unique_ptr<STFT> stft;
+        TierSettings settings;
+        // fftSize - settings.fftSize samples per channel, so every tier has the same latency
+        std::vector<std::vector<float>> delay;
+        int delayPosition = 0;
+        // brings its output to the level of the configuration, see measureLevel ()
+        float gain = 1.0f;
+    };
+
+    std::unique_ptr<OfflineRenderer> makeOfflineRenderer (int numThreads) const;
+    void applyOfflineGain (float* data, int64_t numSamples, float gainValue) const;
+
+    void buildTiers();
+    // output RMS of a frame layout on reference noise, with the configured synthesis (filter bank,
+    // phasors) or the plain inverse FFT of the analysed phases, rateFactor times below the host's rate.
+    // Remembered for the settings it was measured with, see LevelKey
+    float measureLevel (int frameSize, int frameOverlap, bool configured, int rateFactor) const;
+    // output RMS of renderStretched () on the same noise, at the full rate
+    float measureStretchedLevel (OfflineRenderer& renderer, double stretch) const;
+    STFT& getTierStft (int tier) noexcept { return tier == 0 ? *sTFT : *degradedTiers[(size_t)tier - 1].stft; }
+    template <typename Function>
+    void forEachStft (Function&& function)
+    {
+        function (*sTFT);
+        for (Tier& tier : degradedTiers)
+            function (*tier.stft);
+    }
+    // the STFT at the host's rate or the band split's, and BandSplitter ready for it
+    void prepareBandSplit();
+    void processUngoverned (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept;
+    // the tiers and the gain, at the STFT's rate
+    void renderWet (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept;
+    void renderTier (int tier, float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept;
+    void renderTransition (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept;
+    void beginTransition (int tier) noexcept;
+    void restartAtFullQuality() noexcept;
+    void clearTiers() noexcept;
+
+    void allocateBypass();
+    void processBypass (float* const* channels, int numBlockChannels, int numBlockSamples, int stride) noexcept;
+    // the input into the dry ring, swapped for what went in one latency ago when replace is set
+    void delayDry (float* const* channels, int numBlockChannels, int numBlockSamples, int stride, bool replace) noexcept;
+
+    std::unique_ptr<STFT> sTFT;
+    std::vector<std::unique_ptr<Gain_Block>> gainBlocks;
+
+    double sampleRate = 44100.0;
+    int maxBlockSize = 512;
+    int numChannels = 2;
+    int fftSize = 2048;
+    int overlap = 4;
+    int windowType = STFT::windowTypeHann;
+
+    float stochFactor = 0.5f;
+    float noiseLevel = 0.05f;
+    float amp = 0.5f;
+    float lowCutoff = 2000.0f;
+    float silenceThreshold = 1.0e-6f;
+    bool binPruning = false;
+    bool frameBatching = true;
+    bool channelLanes = false;
+    int sinusoidPartials = 0;
+    float sinusoidThresholdDb = -70.0f;
+    int filterBankBands = 0;
+    bool phasorPhases = false;
+    float phasorBias = 0.0f;
+    bool slidingDft = false;
+    std::vector<SpectralNode::Settings> spectralNodes;
+    int envelopeInterval = 1;
+    float envelopeFluxThreshold = 0.0f;
+    // brings the filter bank, the phasors or the envelope decimation to the level of the analysed phases, see buildTiers ()
+    float synthesisGain = 1.0f;
+    // everything measureLevel () depends on, the configured synthesis left at its defaults for the analysed phases
+    struct LevelKey
+    {
+        double sampleRate;
+        int fftSize, frameSize, frameOverlap, rateFactor, windowType;
+        float stochFactor, noiseLevel, lowCutoff;
+        int filterBankBands, envelopeInterval;
+        bool phasorPhases;
+        float phasorBias, envelopeFluxThreshold;
+
+        bool operator== (const LevelKey& other) const noexcept
+        {
+            return sampleRate == other.sampleRate && fftSize == other.fftSize && frameSize == other.frameSize
+                && frameOverlap == other.frameOverlap && rateFactor == other.rateFactor && windowType == other.windowType
+                && stochFactor == other.stochFactor && noiseLevel == other.noiseLevel && lowCutoff == other.lowCutoff
+                && filterBankBands == other.filterBankBands && envelopeInterval == other.envelopeInterval
+                && phasorPhases == other.phasorPhases && phasorBias == other.phasorBias
+                && envelopeFluxThreshold == other.envelopeFluxThreshold;
+        }
+    };
+    static constexpr size_t maxMeasuredLevels = 32;
+    mutable std::vector<std::pair<LevelKey, float>> measuredLevels;
+    bool telemetryEnabled = false;
+
+    // real-time and offline, see setQualityProfiles ()
+    QualityProfile qualityProfiles[2] { { 2048, 4, STFT::windowTypeHann, false }, { 2048, 4, STFT::windowTypeHann, false } };
+    bool hasQualityProfiles = false;
+    bool nonRealtime = false;
+
+    // band split, see setBandSplit (). Every STFT runs at sampleRate / getBandSplitFactor ()
+    float bandSplitFrequency = 0.0f;
+    BandSplitter bandSplitter;
+    std::vector<float*> splitChannels;
+
+    // governor, see setGovernor (). The tiers are only built once prepare () has run
+    bool prepared = false;
+    static constexpr int maxDegradedTiers = 3;
+    std::vector<Tier> degradedTiers;
+    CpuGovernor governor;
+    bool governorEnabled = false;
+    int activeTier = 0;
+    // the tier fading in, -1 if none. It runs alongside for warmUpLength samples, then takes fadeLength to take over
+    int fadingTier = -1;
+    int transitionPosition = 0;
+    int warmUpLength = 0;
+    int fadeLength = 0;
+    std::vector<float> fadeCurve;
+    std::vector<std::vector<float>> transitionBuffers;
+    std::vector<float*> transitionChannels;
+    std::vector<float*> blockChannels;
+    std::atomic<int> qualityTier { 0 };
+    std::atomic<float> cpuLoad { 0.0f };
+
+    // bypass, see setBypassed (). bypassFade goes from 0 (wet) to bypassFadeLength (dry) one step a sample
+    bool bypassed = false;
+    // false while fully bypassed, the STFT only primes its input ring then
+    bool wetRunning = true;
+    int bypassFade = 0;
+    int bypassFadeLength = 1;
+    // samples the wet path still needs before it can fade in, and how much input the ring got while bypassed
+    int bypassWarmUp = 0;
+    int primedSamples = 0;
+    std::vector<float> bypassCurve;
+    std::vector<std::vector<float>> dryDelay;
+    int dryPosition = 0;
+    std::vector<std::vector<float>> wetBuffers;
+    std::vector<float*> wetChannels;
+    std::vector<float*> dryChannels;
+
+    StocSynthEngine (const StocSynthEngine&) = delete;
+    StocSynthEngine& operator= (const StocSynthEngine&) = delete;
+};
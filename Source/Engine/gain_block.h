@@ -20,8 +20,8 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
 #include "math.h"
+#include "DspKernels.h"
 class Gain_Block
 {
 public:
@@ -32,6 +32,7 @@ public:
     
     void prepare(int blocksize)
     {
+        kernels = &DspKernels::get();
         temp_gain = 0;
         numSamples = blocksize;
     }
@@ -40,37 +41,33 @@ public:
     {
         current_gain = gain;
     }
+
+    // where the ramp has got to, for StocSynthEngine::saveState () and seek ()
+    float getRampGain() const noexcept { return temp_gain; }
+    void setRampGain(float gain) noexcept { temp_gain = gain; }
     
-    void process(float* inputptr) noexcept
+    // blockSize is the length of this call, which can be shorter than the prepared one
+    void process(float* inputptr, int blockSize, int stride = 1) noexcept
     {
         //Mono
-        auto* input  = inputptr;
-        auto* output = inputptr;
-         
         if(temp_gain != current_gain)
         {
             // this works for block based processing
-            gain_inc = (current_gain - temp_gain) / numSamples;
-            for (size_t i = 0; i < numSamples; ++i)
-            {
-                temp_gain += gain_inc;
-                const float gain = input[i] * temp_gain;
-                output[i] = gain;
-            }
+            gain_inc = (current_gain - temp_gain) / blockSize;
+            kernels->applyGainRamp (inputptr, stride, temp_gain, gain_inc, blockSize);
             temp_gain = current_gain;
         } else {
-            for (size_t i = 0; i < numSamples; ++i)
-            {
-                const float gain = input[i] * temp_gain;
-                output[i] = gain;
-            }
+            kernels->applyGain (inputptr, stride, temp_gain, blockSize);
         }
              
     }
 private:
-    float temp_gain;
-    float current_gain;
+    float temp_gain = 0;
+    float current_gain = 0;
     float gain_inc = 0;
     int numSamples = 0;
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Gain_Block)
+    const DspKernels* kernels = &DspKernels::get();
+
+    Gain_Block (const Gain_Block&) = delete;
+    Gain_Block& operator= (const Gain_Block&) = delete;
 };
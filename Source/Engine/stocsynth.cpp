@@ -0,0 +1,406 @@
+/*
+  ==============================================================================
+
+    stocsynth.cpp
+    Created: 2 Apr 2023 6:20:15pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "stocsynth.h"
+#include "StocSynthEngine.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <new>
+
+struct stocsynth_engine
+{
+    StocSynthEngine engine;
+    // per channel start pointers into an interleaved buffer, sized once in create
+    std::vector<float*> interleavedChannels;
+};
+
+stocsynth_engine* stocsynth_create (double sampleRate, int numChannels, int maxBlockSize)
+{
+    if (sampleRate <= 0.0 || numChannels <= 0)
+        return nullptr;
+
+    try {
+        auto handle = std::make_unique<stocsynth_engine>();
+        handle->engine.prepare (sampleRate, maxBlockSize, numChannels);
+        handle->interleavedChannels.resize ((size_t)numChannels);
+        return handle.release();
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void stocsynth_destroy (stocsynth_engine* engine)
+{
+    delete engine;
+}
+
+stocsynth_status stocsynth_configure (stocsynth_engine* engine, int fftSize, int overlap, stocsynth_window windowType)
+{
+    if (engine == nullptr || ! StocSynthEngine::isValidConfiguration (fftSize, overlap, (int)windowType))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.configure (fftSize, overlap, (int)windowType);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_apply_preset (stocsynth_engine* engine, stocsynth_preset preset)
+{
+    if (engine == nullptr || preset < STOCSYNTH_PRESET_TRACKING || preset > STOCSYNTH_PRESET_RENDER)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.applyPreset ((int)preset);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_parameter (stocsynth_engine* engine, stocsynth_param param, float value)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    switch (param) {
+        case STOCSYNTH_PARAM_STOCH_FACTOR:  engine->engine.setStochFactor (value); break;
+        case STOCSYNTH_PARAM_NOISE_LEVEL:   engine->engine.setNoiseLevel (value);  break;
+        case STOCSYNTH_PARAM_AMP:           engine->engine.setAmp (value);         break;
+        case STOCSYNTH_PARAM_LOW_CUTOFF:    engine->engine.setLowCutoff (value);   break;
+        case STOCSYNTH_PARAM_SILENCE_THRESHOLD: engine->engine.setSilenceThreshold (value); break;
+        case STOCSYNTH_PARAM_BIN_PRUNING:   engine->engine.setBinPruning (value >= 0.5f); break;
+        default:
+            return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_reset (stocsynth_engine* engine)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.reset();
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_channel_lanes (stocsynth_engine* engine, int enabled)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setChannelLanes (enabled != 0);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_governor (stocsynth_engine* engine, int enabled, float stepDownLoad, float stepUpLoad)
+{
+    if (engine == nullptr || ! (stepDownLoad > 0.0f) || ! (stepUpLoad >= 0.0f))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setGovernorThresholds (stepDownLoad, stepUpLoad);
+        engine->engine.setGovernor (enabled != 0);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+int stocsynth_get_quality_tier (const stocsynth_engine* engine)
+{
+    return engine != nullptr ? engine->engine.getQualityTier() : 0;
+}
+
+float stocsynth_get_cpu_load (const stocsynth_engine* engine)
+{
+    return engine != nullptr ? engine->engine.getCpuLoad() : 0.0f;
+}
+
+stocsynth_status stocsynth_set_filter_bank (stocsynth_engine* engine, int numBands)
+{
+    if (engine == nullptr || numBands < 0)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setFilterBank (numBands);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_phasor_phases (stocsynth_engine* engine, int enabled, float inputPhaseBias)
+{
+    if (engine == nullptr || ! (inputPhaseBias >= 0.0f && inputPhaseBias <= 1.0f))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setPhasorPhases (enabled != 0, inputPhaseBias);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_sliding_dft (stocsynth_engine* engine, int enabled)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setSlidingDft (enabled != 0);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_envelope_decimation (stocsynth_engine* engine, int interval, float fluxThreshold)
+{
+    if (engine == nullptr || interval < 1 || interval > 16 || ! (fluxThreshold >= 0.0f))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setEnvelopeDecimation (interval, fluxThreshold);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_add_spectral_node (stocsynth_engine* engine, stocsynth_node type, int* index)
+{
+    if (engine == nullptr || type < STOCSYNTH_NODE_GATE || type > STOCSYNTH_NODE_TILT)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        const int node = engine->engine.addSpectralNode ((int)type);
+        if (index != nullptr)
+            *index = node;
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_clear_spectral_nodes (stocsynth_engine* engine)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.clearSpectralNodes();
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_spectral_node_parameter (stocsynth_engine* engine, int index, stocsynth_node_param param, float value)
+{
+    if (engine == nullptr || index < 0 || index >= engine->engine.getNumSpectralNodes()
+        || param < STOCSYNTH_GATE_THRESHOLD || param > STOCSYNTH_GATE_DEPTH || std::isnan (value))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    engine->engine.setSpectralNodeParameter (index, (int)param, value);
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_band_split (stocsynth_engine* engine, float splitFrequency)
+{
+    if (engine == nullptr || ! (splitFrequency >= 0.0f && splitFrequency <= 1.0e6f))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setBandSplit (splitFrequency);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_bypass (stocsynth_engine* engine, int bypassed)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    engine->engine.setBypassed (bypassed != 0);
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_set_sinusoids (stocsynth_engine* engine, int maxPartials, float thresholdDb)
+{
+    if (engine == nullptr || maxPartials < 0 || ! std::isfinite (thresholdDb))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.setSinusoids (maxPartials, thresholdDb);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_process_planar (stocsynth_engine* engine, float* const* channels, int numChannels, int numFrames)
+{
+    if (engine == nullptr || channels == nullptr || numChannels <= 0 || numFrames < 0)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    engine->engine.process (channels, numChannels, numFrames);
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_process_interleaved (stocsynth_engine* engine, float* interleaved, int numChannels, int numFrames)
+{
+    if (engine == nullptr || interleaved == nullptr || numChannels <= 0 || numFrames < 0)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    // channels beyond the engine's count are left untouched, same as the planar call
+    const int channelsToProcess = numChannels < (int)engine->interleavedChannels.size() ? numChannels
+                                                                                         : (int)engine->interleavedChannels.size();
+    for (int channel = 0; channel < channelsToProcess; ++channel)
+        engine->interleavedChannels[channel] = interleaved + channel;
+
+    engine->engine.process (engine->interleavedChannels.data(), channelsToProcess, numFrames, numChannels);
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_render_offline (stocsynth_engine* engine, float* const* channels, int numChannels,
+                                           long long numFrames, int numThreads)
+{
+    if (engine == nullptr || channels == nullptr || numChannels <= 0 || numFrames < 0)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.renderOffline (channels, numChannels, (int64_t)numFrames, numThreads);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_render_stretched (stocsynth_engine* engine, const float* const* input, float* const* output,
+                                             int numChannels, long long numInputFrames, double stretch, int numThreads)
+{
+    if (engine == nullptr || input == nullptr || output == nullptr || numChannels <= 0 || numInputFrames < 0 || ! (stretch > 0.0))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.renderStretched (input, output, numChannels, (int64_t)numInputFrames, stretch, numThreads);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_save_state (const stocsynth_engine* engine, void* buffer, size_t capacity, size_t* size)
+{
+    if (engine == nullptr || size == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        const std::vector<uint8_t> state = engine->engine.saveState();
+        *size = state.size();
+        if (buffer != nullptr && capacity >= state.size())
+            std::memcpy (buffer, state.data(), state.size());
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_load_state (stocsynth_engine* engine, const void* data, size_t size)
+{
+    if (engine == nullptr || data == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        if (! engine->engine.loadState (data, size))
+            return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+long long stocsynth_get_preroll_start (const stocsynth_engine* engine, long long position)
+{
+    return engine != nullptr && position >= 0 ? (long long)engine->engine.getPreRollStart ((int64_t)position) : 0;
+}
+
+stocsynth_status stocsynth_seek (stocsynth_engine* engine, long long position, const float* const* preRoll, int numChannels)
+{
+    if (engine == nullptr || position < 0 || numChannels <= 0 || (preRoll == nullptr && position > 0))
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    try {
+        engine->engine.seek ((int64_t)position, preRoll, numChannels);
+    } catch (const std::bad_alloc&) {
+        return STOCSYNTH_ERROR_OUT_OF_MEMORY;
+    }
+    return STOCSYNTH_OK;
+}
+
+long long stocsynth_get_stretched_length (long long numInputFrames, double stretch)
+{
+    return (long long)StocSynthEngine::getStretchedLength ((int64_t)numInputFrames, stretch);
+}
+
+int stocsynth_get_latency (const stocsynth_engine* engine)
+{
+    return engine != nullptr ? engine->engine.getLatencySamples() : 0;
+}
+
+int stocsynth_get_tail (const stocsynth_engine* engine)
+{
+    return engine != nullptr ? engine->engine.getTailSamples() : 0;
+}
+
+stocsynth_status stocsynth_get_frame_counts (const stocsynth_engine* engine, unsigned long long* framesTotal, unsigned long long* framesSkipped)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    if (framesTotal != nullptr)
+        *framesTotal = engine->engine.getFrameCount();
+    if (framesSkipped != nullptr)
+        *framesSkipped = engine->engine.getSkippedFrameCount();
+    return STOCSYNTH_OK;
+}
+
+stocsynth_status stocsynth_get_repair_counts (const stocsynth_engine* engine, unsigned long long* framesRepaired, unsigned long long* valuesRepaired)
+{
+    if (engine == nullptr)
+        return STOCSYNTH_ERROR_INVALID_ARGUMENT;
+
+    if (framesRepaired != nullptr)
+        *framesRepaired = engine->engine.getRepairedFrameCount();
+    if (valuesRepaired != nullptr)
+        *valuesRepaired = engine->engine.getRepairedValueCount();
+    return STOCSYNTH_OK;
+}
+
+const char* stocsynth_get_kernel_isa (void)
+{
+    return DspKernels::getIsaName (DspKernels::getIsa());
+}
@@ -0,0 +1,235 @@
+/*
+  ==============================================================================
+
+    stocsynth.h
+    Created: 2 Apr 2023 6:20:15pm
+    Author:  Onez
+
+    C API of the StocSynth engine, for hosts that want to run it in-process
+    instead of loading the VST3. All processing is in place on the caller's
+    buffers, nothing is copied and nothing is allocated after
+    stocsynth_create () / stocsynth_configure ().
+
+    An engine is not thread safe: configure and process it from one thread,
+    or serialise the calls yourself.
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <stddef.h>
+
+#if defined (_WIN32) && defined (STOCSYNTH_SHARED)
+ #if defined (STOCSYNTH_BUILDING)
+  #define STOCSYNTH_API __declspec(dllexport)
+ #else
+  #define STOCSYNTH_API __declspec(dllimport)
+ #endif
+#elif defined (STOCSYNTH_SHARED) && defined (STOCSYNTH_BUILDING)
+ #define STOCSYNTH_API __attribute__((visibility ("default")))
+#else
+ #define STOCSYNTH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct stocsynth_engine stocsynth_engine;
+
+typedef enum stocsynth_status
+{
+    STOCSYNTH_OK = 0,
+    STOCSYNTH_ERROR_INVALID_ARGUMENT = -1,
+    STOCSYNTH_ERROR_OUT_OF_MEMORY = -2
+} stocsynth_status;
+
+/* 256 / 2x, 2048 / 4x (the plugin default) and 8192 / 8x, all Hann */
+typedef enum stocsynth_preset
+{
+    STOCSYNTH_PRESET_TRACKING = 0,
+    STOCSYNTH_PRESET_MIX,
+    STOCSYNTH_PRESET_RENDER
+} stocsynth_preset;
+
+typedef enum stocsynth_window
+{
+    STOCSYNTH_WINDOW_RECTANGULAR = 0,
+    STOCSYNTH_WINDOW_BARTLETT,
+    STOCSYNTH_WINDOW_HANN,
+    STOCSYNTH_WINDOW_HAMMING
+} stocsynth_window;
+
+/* same names and ranges as the plugin parameters */
+typedef enum stocsynth_param
+{
+    STOCSYNTH_PARAM_STOCH_FACTOR = 0,   /* 0.1 .. 1.0,     default 0.5  */
+    STOCSYNTH_PARAM_NOISE_LEVEL,        /* 0.0 .. 0.1,     default 0.05 */
+    STOCSYNTH_PARAM_AMP,                /* 0.01 .. 2.0,    default 0.5  */
+    STOCSYNTH_PARAM_LOW_CUTOFF,         /* 10 .. 20000 Hz, default 2000 */
+    /* frames whose input peak (linear) is at or below this are skipped
+       without any FFT work, default 1e-6 (-120 dBFS), 0 = digital silence only */
+    STOCSYNTH_PARAM_SILENCE_THRESHOLD,
+    /* 0 or 1, default 0. When on, only the bins below LowCutoff plus a short
+       taper are resynthesised and everything above is silent. Much cheaper
+       for low cutoffs, but it removes the high band the default mode keeps. */
+    STOCSYNTH_PARAM_BIN_PRUNING
+} stocsynth_param;
+
+/* spectral nodes, see stocsynth_add_spectral_node () */
+typedef enum stocsynth_node
+{
+    STOCSYNTH_NODE_GATE = 0,
+    STOCSYNTH_NODE_TILT
+} stocsynth_node;
+
+typedef enum stocsynth_node_param
+{
+    STOCSYNTH_GATE_THRESHOLD = 0,       /* -120 .. 0 dBFS of a sine in the bin, default -60 */
+    STOCSYNTH_GATE_DEPTH = 1,           /* 0 .. 120 dB the bins below it lose, default 80 */
+    STOCSYNTH_TILT_SLOPE = 0,           /* -12 .. 12 dB per octave, default 0 */
+    STOCSYNTH_TILT_PIVOT = 1            /* 20 .. 20000 Hz where the tilt is 0 dB, default 1000 */
+} stocsynth_node_param;
+
+/* Returns NULL on bad arguments or allocation failure.
+   maxBlockSize is only a hint, process calls may pass any number of frames.
+   The engine starts configured as 2048 / 4x / Hann, like the plugin. */
+STOCSYNTH_API stocsynth_engine* stocsynth_create (double sampleRate, int numChannels, int maxBlockSize);
+STOCSYNTH_API void stocsynth_destroy (stocsynth_engine* engine);
+
+/* fftSize: power of two in 64..16384, overlap: power of two <= fftSize.
+   Reallocates and clears the engine state, so don't call it from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_configure (stocsynth_engine* engine, int fftSize, int overlap, stocsynth_window windowType);
+/* stocsynth_configure () with one of the presets */
+STOCSYNTH_API stocsynth_status stocsynth_apply_preset (stocsynth_engine* engine, stocsynth_preset preset);
+STOCSYNTH_API stocsynth_status stocsynth_set_parameter (stocsynth_engine* engine, stocsynth_param param, float value);
+/* clears the ring buffers, e.g. between two unrelated renders */
+STOCSYNTH_API stocsynth_status stocsynth_reset (stocsynth_engine* engine);
+
+/* 0 or 1, default 0. Runs all channels side by side in SIMD lanes with approximate
+   math, about -130 dB from the default output and 2-3x cheaper for 4 or more channels.
+   Reallocates like stocsynth_configure (), so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_channel_lanes (stocsynth_engine* engine, int enabled);
+
+/* Sinusoidal plus residual mode: up to maxPartials (0 = off, the default) spectral peaks louder than
+   thresholdDb (dBFS, e.g. -70) are tracked frame to frame and played by an additive oscillator bank,
+   and only what they leave goes through the stochastic resynthesis. Needs an overlap of 2 or more.
+   Disables frame batching and channel lanes while on. Reallocates, so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_sinusoids (stocsynth_engine* engine, int maxPartials, float thresholdDb);
+
+/* CPU governor, 0 or 1, default 0. When the engine's blocks take more than stepDownLoad of their
+   real-time length (e.g. 0.5), it steps down to a cheaper quality tier: half the overlap, then half
+   the FFT size, then bin pruning. Once they take less than stepUpLoad (e.g. 0.2) for a few seconds
+   it steps back up. The latency does not change, and every step crossfades. Reallocates, so not
+   from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_governor (stocsynth_engine* engine, int enabled, float stepDownLoad, float stepUpLoad);
+/* the tier playing, 0 = full quality, and the averaged load. May be called from any thread. */
+STOCSYNTH_API int stocsynth_get_quality_tier (const stocsynth_engine* engine);
+STOCSYNTH_API float stocsynth_get_cpu_load (const stocsynth_engine* engine);
+
+/* Synthesise the noise with numBands (4 .. 64) filtered noise bands instead of an inverse FFT per hop,
+   0 = off (default). No FFT latency (stocsynth_get_latency () becomes 0, or the band split's delay),
+   and the synthesis costs the same at any FFT size. Turns the sinusoids off. Reallocates, so not from
+   a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_filter_bank (stocsynth_engine* engine, int numBands);
+
+/* Random phases from a table of unit phasors instead of the analysed ones (0 or 1, default 0): no
+   trigonometry per bin. inputPhaseBias (0 .. 1) pulls them towards the input's phases. The level is
+   matched to the default. Reallocates, so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_phasor_phases (stocsynth_engine* engine, int enabled, float inputPhaseBias);
+
+/* High overlap mode, 0 or 1, default 0: for hops of 8 to 32 samples (an overlap of fftSize / hop in
+   stocsynth_configure ()). A sliding DFT updates the analysed bins every sample instead of a forward
+   FFT every hop, with the window applied in the frequency domain. Worth it with bin pruning, where only
+   the bins below LowCutoff are analysed. Hann, Hamming and rectangular windows only, Bartlett keeps the
+   FFT. Reallocates, so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_sliding_dft (stocsynth_engine* engine, int enabled);
+
+/* Temporal envelope decimation for slowly changing sources: the frames are analysed only every interval
+   hops (2 .. 16, 1 = off, the default) and the envelope ramps between analyses, with new random phases
+   every hop so the noise stays fresh. With fluxThreshold > 0 (e.g. 0.5) a hop is also analysed straight
+   away when its band levels, from a frame an eighth as long, moved by more than that share since the last
+   analysis. Not with the sinusoids, the filter bank or the sliding DFT. Seeking needs two intervals of
+   hops more pre-roll, stocsynth_get_preroll_start () includes them. Reallocates, so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_envelope_decimation (stocsynth_engine* engine, int interval, float fluxThreshold);
+
+/* Spectral effects on the same frames as the stochastic resynthesis, after it and before its inverse
+   FFT: a chain of them adds no transform and no latency. stocsynth_add_spectral_node () appends a node
+   with its default parameters and writes its index to *index (may be NULL), and the nodes run in the
+   order they were added. The filter bank plays without them. Adding and clearing reallocate, so not
+   from a real-time thread. Parameters may be set from a real-time thread, between process calls. */
+STOCSYNTH_API stocsynth_status stocsynth_add_spectral_node (stocsynth_engine* engine, stocsynth_node type, int* index);
+STOCSYNTH_API stocsynth_status stocsynth_clear_spectral_nodes (stocsynth_engine* engine);
+STOCSYNTH_API stocsynth_status stocsynth_set_spectral_node_parameter (stocsynth_engine* engine, int index, stocsynth_node_param param, float value);
+
+/* Multirate band split at splitFrequency Hz, 0 = off (default). Only the band below it goes through
+   the STFT, decimated by a cascade of half-band filters to the lowest rate that still holds it (2x to
+   64x lower), with an FFT as many times smaller, so the bins keep their width. Everything above comes
+   out dry and delayed. The filters add a few ms to stocsynth_get_latency (). Meant for low cutoffs at
+   high rates: 2000 Hz at 96 kHz runs the STFT at 6 kHz. Set it at or above LowCutoff. Reallocates,
+   so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_set_band_split (stocsynth_engine* engine, float splitFrequency);
+
+/* Bypass, 0 or 1, default 0. The output crossfades to the input delayed by the latency, and while
+   fully bypassed the engine only copies samples. Coming back waits about one FFT frame before fading
+   the processed signal in. May be called from a real-time thread, between process calls. */
+STOCSYNTH_API stocsynth_status stocsynth_set_bypass (stocsynth_engine* engine, int bypassed);
+
+/* channels[c] points to numFrames samples of channel c, processed in place.
+   numChannels may be smaller than the one given to stocsynth_create (). */
+STOCSYNTH_API stocsynth_status stocsynth_process_planar (stocsynth_engine* engine, float* const* channels, int numChannels, int numFrames);
+/* interleaved frames (c0 c1 c0 c1 ...), processed in place */
+STOCSYNTH_API stocsynth_status stocsynth_process_interleaved (stocsynth_engine* engine, float* interleaved, int numChannels, int numFrames);
+
+/* A whole file in place, spread over numThreads threads (0 = one per core).
+   Bit-identical to stocsynth_reset () followed by stocsynth_process_planar ()
+   over the file in maxBlockSize blocks (channel lanes off), and leaves the
+   engine reset. Allocates and starts threads, so not from a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_render_offline (stocsynth_engine* engine, float* const* channels, int numChannels,
+                                                         long long numFrames, int numThreads);
+
+/* Time-stretches the stochastic component of a whole file by 0.25 .. 4 (clamped): envelopes are
+   interpolated between analysis frames and resynthesised with new random phases every hop, much
+   cheaper than a phase vocoder. output[c] must hold stocsynth_get_stretched_length () frames.
+   Threads and reset like stocsynth_render_offline (). */
+STOCSYNTH_API stocsynth_status stocsynth_render_stretched (stocsynth_engine* engine, const float* const* input, float* const* output,
+                                                           int numChannels, long long numInputFrames, double stretch, int numThreads);
+/* Checkpoints for renders split into chunks: the state a process call leaves for the next one, as a
+   binary blob for the same build on the same kind of machine. With buffer NULL (or too small) *size
+   only gets the size it needs. Loading needs an engine created and configured the same way; the next
+   process call then carries on exactly where the saving engine stopped. Parameters are not included.
+   Not for a real-time thread. */
+STOCSYNTH_API stocsynth_status stocsynth_save_state (const stocsynth_engine* engine, void* buffer, size_t capacity, size_t* size);
+STOCSYNTH_API stocsynth_status stocsynth_load_state (stocsynth_engine* engine, const void* data, size_t size);
+
+/* Seeking from pre-roll, so chunks can be rendered on their own: preRoll[c] holds the input from
+   stocsynth_get_preroll_start (engine, position) up to position. From then on the output is bit for
+   bit what a render from frame 0 gives from position on, if position is on one of its block
+   boundaries and the governor and bypass are off. The filter bank and sinusoids only settle to it,
+   chain stocsynth_save_state () across chunks for those. Not for a real-time thread. */
+STOCSYNTH_API long long stocsynth_get_preroll_start (const stocsynth_engine* engine, long long position);
+STOCSYNTH_API stocsynth_status stocsynth_seek (stocsynth_engine* engine, long long position, const float* const* preRoll, int numChannels);
+
+STOCSYNTH_API long long stocsynth_get_stretched_length (long long numInputFrames, double stretch);
+
+/* Delay of the output against the input in frames, one fftSize. Changes with configure. */
+STOCSYNTH_API int stocsynth_get_latency (const stocsynth_engine* engine);
+/* frames of output still to come after the input stops (latency plus one FFT frame) */
+STOCSYNTH_API int stocsynth_get_tail (const stocsynth_engine* engine);
+
+/* STFT frames (per channel and hop) since create / reset, and how many of them
+   were skipped as silent. May be called from any thread. */
+STOCSYNTH_API stocsynth_status stocsynth_get_frame_counts (const stocsynth_engine* engine, unsigned long long* framesTotal, unsigned long long* framesSkipped);
+
+/* Frames since create / reset in which NaN, Inf, denormals or log10 of a zero bin had to be
+   repaired before they could reach the output, and how many values that was. Exact zero bins
+   (DC, some steady tones) count as well. May be called from any thread. */
+STOCSYNTH_API stocsynth_status stocsynth_get_repair_counts (const stocsynth_engine* engine, unsigned long long* framesRepaired, unsigned long long* valuesRepaired);
+
+/* The instruction set the DSP kernels run with: "sse2", "avx2" or "avx512", the best this CPU has
+   unless STOCSYNTH_ISA in the environment asked for a lower one. The output is the same with each. */
+STOCSYNTH_API const char* stocsynth_get_kernel_isa (void);
+
+#ifdef __cplusplus
+}
+#endif
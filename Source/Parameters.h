@@ -28,3 +28,16 @@ const juce::StringArray FFtSizes {
         "8192",
         "16384"
 };
+const juce::StringArray overlaps {
+        "2x",
+        "4x",
+        "8x",
+        "16x",
+        "32x"
+};
+// same order as StocSynthEngine::Preset
+const juce::StringArray latencyPresets {
+        "Tracking (256 / 2x)",
+        "Mix (2048 / 4x)",
+        "Render (8192 / 8x)"
+};
@@ -11,15 +11,39 @@
 
 //==============================================================================
 StocSynthAudioProcessorEditor::StocSynthAudioProcessorEditor (StocSynthAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), spectrumDisplay (p.getSpectrumTap())
 {
+    addAndMakeVisible (spectrumDisplay);
+
+    const char* parameterIDs[numParameters] { "LowCutoff", "StochFactor", "NoiseLevel", "Amp" };
+    for (int i = 0; i < numParameters; ++i) {
+        sliders[i].setSliderStyle (juce::Slider::RotaryHorizontalVerticalDrag);
+        sliders[i].setTextBoxStyle (juce::Slider::TextBoxBelow, false, 80, 18);
+        addAndMakeVisible (sliders[i]);
+
+        labels[i].setText (parameterIDs[i], juce::dontSendNotification);
+        labels[i].setJustificationType (juce::Justification::centred);
+        labels[i].attachToComponent (&sliders[i], false);
+        addAndMakeVisible (labels[i]);
+
+        attachments[i] = std::make_unique<SliderAttachment> (audioProcessor.treeState, parameterIDs[i], sliders[i]);
+    }
+
+    addAndMakeVisible (governorButton);
+    governorAttachment = std::make_unique<ButtonAttachment> (audioProcessor.treeState, "CpuGovernor", governorButton);
+    qualityLabel.setJustificationType (juce::Justification::centredRight);
+    addAndMakeVisible (qualityLabel);
+    timerCallback();
+    startTimerHz (4);
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (640, 450);
 }
 
 StocSynthAudioProcessorEditor::~StocSynthAudioProcessorEditor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -27,14 +51,24 @@ void StocSynthAudioProcessorEditor::paint (juce::Graphics& g)
 {
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
-
-    g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
 }
 
 void StocSynthAudioProcessorEditor::resized()
 {
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
+    auto area = getLocalBounds().reduced (10);
+    auto controls = area.removeFromBottom (130);
+    auto status = area.removeFromBottom (30);
+    governorButton.setBounds (status.removeFromLeft (140));
+    qualityLabel.setBounds (status);
+    spectrumDisplay.setBounds (area.withTrimmedBottom (10));
+
+    controls.removeFromTop (20); // labels sit above the sliders
+    const int sliderWidth = controls.getWidth() / numParameters;
+    for (auto& slider : sliders)
+        slider.setBounds (controls.removeFromLeft (sliderWidth).reduced (8, 0));
+}
+
+void StocSynthAudioProcessorEditor::timerCallback()
+{
+    qualityLabel.setText (audioProcessor.getQualityText(), juce::dontSendNotification);
 }
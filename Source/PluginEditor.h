@@ -10,11 +10,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "SpectrumDisplay.h"
 
 //==============================================================================
 /**
 */
-class StocSynthAudioProcessorEditor  : public juce::AudioProcessorEditor
+class StocSynthAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                       private juce::Timer
 {
 public:
     StocSynthAudioProcessorEditor (StocSynthAudioProcessor&);
@@ -25,9 +27,27 @@ public:
     void resized() override;
 
 private:
+    using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
+    using ButtonAttachment = juce::AudioProcessorValueTreeState::ButtonAttachment;
+
+    // refreshes the quality readout
+    void timerCallback() override;
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     StocSynthAudioProcessor& audioProcessor;
 
+    SpectrumDisplay spectrumDisplay;
+
+    // same order as the parameter layout
+    static constexpr int numParameters = 4;
+    juce::Slider sliders[numParameters];
+    juce::Label labels[numParameters];
+    std::unique_ptr<SliderAttachment> attachments[numParameters];
+
+    juce::ToggleButton governorButton { "CpuGovernor" };
+    std::unique_ptr<ButtonAttachment> governorAttachment;
+    juce::Label qualityLabel;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StocSynthAudioProcessorEditor)
 };
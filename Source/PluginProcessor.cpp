@@ -9,6 +9,15 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    // the ones that reallocate the engine, see parameterChanged()
+    const char* const reconfiguringParameters[] {
+        "LatencyPreset", "CpuGovernor", "RealtimeBinPruning", "OfflineProfile",
+        "OfflineFftSize", "OfflineOverlap", "OfflineWindow", "OfflineBinPruning"
+    };
+}
+
 //==============================================================================
 StocSynthAudioProcessor::StocSynthAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -26,9 +35,20 @@ StocSynthAudioProcessor::StocSynthAudioProcessor()
     m_Decimation = treeState.getRawParameterValue("NoiseLevel");
     m_Amp  = treeState.getRawParameterValue("Amp");
     m_Cutoff  = treeState.getRawParameterValue("LowCutoff");
-    gain_BlockL = std::make_unique<Gain_Block>();
-    gain_BlockR = std::make_unique<Gain_Block>();
-    sTFT = std::make_unique<STFT>();
+    m_LatencyPreset  = treeState.getRawParameterValue("LatencyPreset");
+    m_CpuGovernor  = treeState.getRawParameterValue("CpuGovernor");
+    m_Bypass  = treeState.getRawParameterValue("Bypass");
+    m_RealtimeBinPruning  = treeState.getRawParameterValue("RealtimeBinPruning");
+    m_OfflineProfile  = treeState.getRawParameterValue("OfflineProfile");
+    m_OfflineFftSize  = treeState.getRawParameterValue("OfflineFftSize");
+    m_OfflineOverlap  = treeState.getRawParameterValue("OfflineOverlap");
+    m_OfflineWindow  = treeState.getRawParameterValue("OfflineWindow");
+    m_OfflineBinPruning  = treeState.getRawParameterValue("OfflineBinPruning");
+    for (auto* parameterID : reconfiguringParameters)
+        treeState.addParameterListener(parameterID, this);
+    engine = std::make_unique<StocSynthEngine>();
+    // always on, so opening the editor doesn't change what the audio thread does
+    engine->setTelemetryEnabled(true);
     
     
     
@@ -36,6 +56,9 @@ StocSynthAudioProcessor::StocSynthAudioProcessor()
 
 StocSynthAudioProcessor::~StocSynthAudioProcessor()
 {
+    for (auto* parameterID : reconfiguringParameters)
+        treeState.removeParameterListener(parameterID, this);
+    cancelPendingUpdate();
 }
 juce::AudioProcessorValueTreeState::ParameterLayout
 StocSynthAudioProcessor::createParameterLayout()
@@ -52,10 +75,37 @@ StocSynthAudioProcessor::createParameterLayout()
     
     
     auto filter = std::make_unique<juce::AudioParameterFloat>("LowCutoff","LowCutoff",10.0,20000.0,2000);
+    
+    auto latencyPreset = std::make_unique<juce::AudioParameterChoice>("LatencyPreset","LatencyPreset",latencyPresets,StocSynthEngine::presetMix);
+    
+    // coarser noise rather than a dropout when the session gets heavy, off until asked for as it changes the sound
+    auto cpuGovernor = std::make_unique<juce::AudioParameterBool>("CpuGovernor","CpuGovernor",false);
+    
+    // hosts map their bypass button to this one, see getBypassParameter()
+    auto bypass = std::make_unique<juce::AudioParameterBool>("Bypass","Bypass",false);
+    
+    // real-time profile: LatencyPreset plus this
+    auto realtimeBinPruning = std::make_unique<juce::AudioParameterBool>("RealtimeBinPruning","RealtimeBinPruning",false);
+    
+    // offline profile, what bounces run with unless it is off (then they get the real-time one)
+    auto offlineProfile = std::make_unique<juce::AudioParameterBool>("OfflineProfile","OfflineProfile",true);
+    auto offlineFftSize = std::make_unique<juce::AudioParameterChoice>("OfflineFftSize","OfflineFftSize",FFtSizes,FFtSizes.indexOf("8192"));
+    auto offlineOverlap = std::make_unique<juce::AudioParameterChoice>("OfflineOverlap","OfflineOverlap",overlaps,overlaps.indexOf("8x"));
+    auto offlineWindow = std::make_unique<juce::AudioParameterChoice>("OfflineWindow","OfflineWindow",windowType,STFT::windowTypeHann);
+    auto offlineBinPruning = std::make_unique<juce::AudioParameterBool>("OfflineBinPruning","OfflineBinPruning",false);
     params.push_back(std::move(filter));
     params.push_back(std::move(stochFactor));
     params.push_back(std::move(decimation));
     params.push_back(std::move(amp));
+    params.push_back(std::move(latencyPreset));
+    params.push_back(std::move(cpuGovernor));
+    params.push_back(std::move(bypass));
+    params.push_back(std::move(realtimeBinPruning));
+    params.push_back(std::move(offlineProfile));
+    params.push_back(std::move(offlineFftSize));
+    params.push_back(std::move(offlineOverlap));
+    params.push_back(std::move(offlineWindow));
+    params.push_back(std::move(offlineBinPruning));
     return {params.begin(),params.end()};
 }
 //==============================================================================
@@ -93,7 +143,8 @@ bool StocSynthAudioProcessor::isMidiEffect() const
 
 double StocSynthAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    const double sampleRate = getSampleRate();
+    return sampleRate > 0.0 ? engine->getTailSamples() / sampleRate : 0.0;
 }
 
 int StocSynthAudioProcessor::getNumPrograms()
@@ -123,18 +174,92 @@ void StocSynthAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void StocSynthAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    sTFT->setup(2);
-    sTFT->updateParameters(2048,
-                            4,
-                           2);
-    gain_BlockL->prepare(samplesPerBlock);
-    gain_BlockR->prepare(samplesPerBlock);
+    // everything below only takes note, prepare() builds the governor's tiers once
+    engine->release();
+    engine->setQualityProfiles(getQualityProfile(false), getQualityProfile(true));
+    engine->setNonRealtime(isNonRealtime());
+    // a bounce has no deadline, the governor would only lower its quality
+    engine->setGovernor(*m_CpuGovernor > 0.5f && ! isNonRealtime());
+    engine->prepare(sampleRate, samplesPerBlock, getTotalNumOutputChannels());
+    setLatencySamples(engine->getLatencySamples());
+}
+
+void StocSynthAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
+    // hosts call this from whichever thread, and most prepare again before the bounce anyway
+    triggerAsyncUpdate();
+}
+
+StocSynthEngine::QualityProfile StocSynthAudioProcessor::getQualityProfile (bool offline) const
+{
+    if (offline && *m_OfflineProfile > 0.5f)
+        return { string_to_fftsize((int)*m_OfflineFftSize), 2 << (int)*m_OfflineOverlap, (int)*m_OfflineWindow, *m_OfflineBinPruning > 0.5f };
+
+    const auto& preset = StocSynthEngine::getPresetSettings((int)*m_LatencyPreset);
+    return { preset.fftSize, preset.overlap, preset.windowType, *m_RealtimeBinPruning > 0.5f };
+}
+
+void StocSynthAudioProcessor::parameterChanged (const juce::String& parameterID, float newValue)
+{
+    juce::ignoreUnused (parameterID, newValue);
+    // can come from the audio thread during automation, so don't touch the engine here
+    triggerAsyncUpdate();
+}
+
+void StocSynthAudioProcessor::handleAsyncUpdate()
+{
+    applyQualityProfile();
+    applyGovernor();
+}
+
+void StocSynthAudioProcessor::applyQualityProfile()
+{
+    const bool offline = isNonRealtime();
+    engine->setQualityProfiles(getQualityProfile(false), getQualityProfile(true));
+    if (engine->getQualityProfile(offline) == engine->getCurrentProfile()) {
+        engine->setNonRealtime(offline);
+        return;
+    }
+
+    // takes the callback lock, so no processBlock is running while the engine reallocates
+    suspendProcessing(true);
+    engine->setNonRealtime(offline);
+    setLatencySamples(engine->getLatencySamples());
+    suspendProcessing(false);
+}
+
+void StocSynthAudioProcessor::applyGovernor()
+{
+    const bool shouldGovern = *m_CpuGovernor > 0.5f && ! isNonRealtime();
+    if (shouldGovern == engine->isGovernorEnabled())
+        return;
+
+    // builds the tiers, same as the preset
+    suspendProcessing(true);
+    engine->setGovernor(shouldGovern);
+    suspendProcessing(false);
+}
+
+juce::String StocSynthAudioProcessor::getQualityText() const
+{
+    if (engine->isBypassed())
+        return "Bypassed";
+    if (! engine->isGovernorEnabled())
+        return "Quality: full";
+
+    const int tier = engine->getQualityTier();
+    const auto settings = engine->getQualityTierSettings(tier);
+    juce::String text = tier == 0 ? "Quality: full" : "Quality: reduced " + juce::String(tier) + "/" + juce::String(engine->getNumQualityTiers() - 1);
+    text << " (" << settings.fftSize << " / " << settings.overlap << "x" << (settings.binPruning ? ", pruned" : "") << ")";
+    text << "   CPU " << juce::roundToInt(100.0f * engine->getCpuLoad()) << "%";
+    return text;
 }
 
 void StocSynthAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // the governor's tiers, prepareToPlay() builds them again
+    engine->release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -164,6 +289,22 @@ bool StocSynthAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 #endif
 
 void StocSynthAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processEngine(buffer, *m_Bypass > 0.5f);
+}
+
+void StocSynthAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    // still through the engine: the dry path has to keep the latency, and the crossfade needs the STFT running
+    processEngine(buffer, true);
+}
+
+juce::AudioProcessorParameter* StocSynthAudioProcessor::getBypassParameter() const
+{
+    return treeState.getParameter("Bypass");
+}
+
+void StocSynthAudioProcessor::processEngine (juce::AudioBuffer<float>& buffer, bool bypassed)
 {
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
@@ -173,16 +314,12 @@ void StocSynthAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    sTFT->processBlock(buffer);
-    sTFT->updateStochfactor(*m_StochFactor);
-    sTFT->updatedecimation(*m_Decimation);
-    sTFT->updatecutoff(*m_Cutoff);
-    auto left = buffer.getWritePointer(0);
-    auto right =  buffer.getWritePointer(1);
-    gain_BlockL->setGain(*m_Amp);
-    gain_BlockL->process(left);
-    gain_BlockR->setGain(*m_Amp);
-    gain_BlockR->process(right);
+    engine->setStochFactor(*m_StochFactor);
+    engine->setNoiseLevel(*m_Decimation);
+    engine->setLowCutoff(*m_Cutoff);
+    engine->setAmp(*m_Amp);
+    engine->setBypassed(bypassed);
+    engine->process(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
 }
 
 //==============================================================================
@@ -193,7 +330,7 @@ bool StocSynthAudioProcessor::hasEditor() const
 
 juce::AudioProcessorEditor* StocSynthAudioProcessor::createEditor()
 {
-    return new juce::GenericAudioProcessorEditor(*this);//new StocSynthAudioProcessorEditor (*this);
+    return new StocSynthAudioProcessorEditor (*this);
 }
 
 //==============================================================================
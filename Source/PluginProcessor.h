@@ -9,14 +9,15 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "FFT_juce.h"
+#include "Engine/StocSynthEngine.h"
 #include "Parameters.h"
 #include "string_to_fftsize.h"
-#include "gain_block.h"
 //==============================================================================
 /**
 */
-class StocSynthAudioProcessor  : public juce::AudioProcessor
+class StocSynthAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::AudioProcessorValueTreeState::Listener,
+                                 private juce::AsyncUpdater
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -35,6 +36,11 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    // the dry input at the same latency, see StocSynthEngine::setBypassed ()
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    juce::AudioProcessorParameter* getBypassParameter() const override;
+    // bounces get the offline quality profile, see applyQualityProfile()
+    void setNonRealtime (bool isNonRealtime) noexcept override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -59,16 +65,36 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
     juce::AudioProcessorValueTreeState treeState;
+
+    // read by the editor's spectrum display, never from the audio thread
+    SpectrumTap& getSpectrumTap() { return engine->getSpectrumTap(); }
+    // the governor's quality tier and load, for the editor
+    juce::String getQualityText() const;
 private:
     // create parameter layout
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
-    std::unique_ptr<STFT> sTFT;
-    std::unique_ptr<Gain_Block> gain_BlockL;
-    std::unique_ptr<Gain_Block> gain_BlockR;
+    // the preset reallocates the engine, so it is applied on the message thread
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+    // LatencyPreset and RealtimeBinPruning, or the Offline* parameters while the host renders offline
+    StocSynthEngine::QualityProfile getQualityProfile (bool offline) const;
+    void applyQualityProfile();
+    void applyGovernor();
+    void processEngine (juce::AudioBuffer<float>& buffer, bool bypassed);
+    std::unique_ptr<StocSynthEngine> engine;
     std::atomic<float>* m_StochFactor  = nullptr;
     std::atomic<float>* m_Decimation  = nullptr;
     std::atomic<float>* m_Amp  = nullptr;
     std::atomic<float>* m_Cutoff  = nullptr;
+    std::atomic<float>* m_LatencyPreset  = nullptr;
+    std::atomic<float>* m_CpuGovernor  = nullptr;
+    std::atomic<float>* m_Bypass  = nullptr;
+    std::atomic<float>* m_RealtimeBinPruning  = nullptr;
+    std::atomic<float>* m_OfflineProfile  = nullptr;
+    std::atomic<float>* m_OfflineFftSize  = nullptr;
+    std::atomic<float>* m_OfflineOverlap  = nullptr;
+    std::atomic<float>* m_OfflineWindow  = nullptr;
+    std::atomic<float>* m_OfflineBinPruning  = nullptr;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StocSynthAudioProcessor)
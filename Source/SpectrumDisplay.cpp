@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    SpectrumDisplay.cpp
+    Created: 9 Apr 2023 4:05:52pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#include "SpectrumDisplay.h"
+
+//==============================================================================
+SpectrumDisplay::SpectrumDisplay (SpectrumTap& tapToRead)
+    : tap (tapToRead)
+{
+    setOpaque (true);
+    startTimerHz (frameRateHz);
+}
+
+SpectrumDisplay::~SpectrumDisplay()
+{
+    stopTimer();
+}
+
+//==============================================================================
+void SpectrumDisplay::paint (juce::Graphics& g)
+{
+    // both images are already rendered, this only blits whatever area is being repainted
+    g.drawImageAt (backgroundImage, 0, 0);
+    g.drawImageAt (curveImage, 0, 0);
+}
+
+void SpectrumDisplay::resized()
+{
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+
+    backgroundImage = juce::Image (juce::Image::RGB, getWidth(), getHeight(), true);
+    curveImage = juce::Image (juce::Image::ARGB, getWidth(), getHeight(), true);
+    curveBounds = {};
+    renderBackground();
+    repaint();
+}
+
+void SpectrumDisplay::timerCallback()
+{
+    if (curveImage.isNull() || ! tap.update())
+        return;
+
+    const SpectrumSnapshot& snapshot = tap.getReadBuffer();
+    if (snapshot.sampleRate != lastSampleRate) {
+        lastSampleRate = snapshot.sampleRate;
+        renderBackground();
+        repaint();
+    }
+
+    repaint (renderCurves (snapshot));
+}
+
+//==============================================================================
+void SpectrumDisplay::renderBackground()
+{
+    juce::Graphics g (backgroundImage);
+    g.fillAll (juce::Colour (0xff15171a));
+
+    const float sampleRate = lastSampleRate > 0.0f ? lastSampleRate : 44100.0f;
+    g.setFont (11.0f);
+
+    for (float frequency : { 50.0f, 100.0f, 200.0f, 500.0f, 1000.0f, 2000.0f, 5000.0f, 10000.0f, 20000.0f }) {
+        if (frequency >= 0.5f * sampleRate)
+            break;
+
+        const float x = frequencyToX (frequency, sampleRate);
+        g.setColour (juce::Colours::white.withAlpha (0.08f));
+        g.drawVerticalLine (juce::roundToInt (x), 0.0f, (float)getHeight());
+        g.setColour (juce::Colours::white.withAlpha (0.4f));
+        g.drawText (frequency >= 1000.0f ? juce::String ((int)(frequency / 1000.0f)) + "k" : juce::String ((int)frequency),
+                    juce::roundToInt (x) + 2, getHeight() - 14, 40, 12, juce::Justification::left);
+    }
+
+    for (float decibels = minDecibels; decibels <= maxDecibels; decibels += 20.0f) {
+        const float y = decibelsToY (decibels);
+        g.setColour (juce::Colours::white.withAlpha (0.08f));
+        g.drawHorizontalLine (juce::roundToInt (y), 0.0f, (float)getWidth());
+        g.setColour (juce::Colours::white.withAlpha (0.4f));
+        g.drawText (juce::String ((int)decibels) + " dB", 2, juce::roundToInt (y) + 1, 50, 12, juce::Justification::left);
+    }
+}
+
+juce::Rectangle<int> SpectrumDisplay::renderCurves (const SpectrumSnapshot& snapshot)
+{
+    juce::Path magnitude, envelope, kernel;
+    const float bottom = (float)getHeight();
+
+    kernel.startNewSubPath (frequencyToX (SpectrumSnapshot::minFrequency, snapshot.sampleRate), bottom);
+    for (int point = 0; point < SpectrumSnapshot::numPoints; ++point) {
+        const float x = frequencyToX (SpectrumSnapshot::getPointFrequency (point, snapshot.sampleRate), snapshot.sampleRate);
+        const float magnitudeY = decibelsToY (snapshot.magnitude[point]);
+        const float envelopeY = decibelsToY (snapshot.envelope[point]);
+
+        if (point == 0) {
+            magnitude.startNewSubPath (x, magnitudeY);
+            envelope.startNewSubPath (x, envelopeY);
+        } else {
+            magnitude.lineTo (x, magnitudeY);
+            envelope.lineTo (x, envelopeY);
+        }
+        kernel.lineTo (x, bottom - snapshot.kernel[point] * 0.5f * bottom);
+    }
+    kernel.lineTo ((float)getWidth(), bottom);
+    kernel.closeSubPath();
+
+    // wipe only what the previous curves covered, the rest of the image is still transparent
+    const juce::Rectangle<int> previousBounds = curveBounds;
+    curveImage.clear (previousBounds);
+
+    curveBounds = kernel.getBounds().getUnion (envelope.getBounds())
+                                    .getUnion (magnitude.getBounds())
+                                    .expanded (2.0f)
+                                    .getSmallestIntegerContainer()
+                                    .getIntersection (getLocalBounds());
+
+    juce::Graphics g (curveImage);
+    g.setColour (juce::Colour (0xff3f7fbf).withAlpha (0.25f));
+    g.fillPath (kernel);
+    if (! snapshot.silent) {
+        g.setColour (juce::Colour (0xffe0e0e0));
+        g.strokePath (magnitude, juce::PathStrokeType (1.0f));
+        g.setColour (juce::Colour (0xffff9a3c));
+        g.strokePath (envelope, juce::PathStrokeType (1.5f));
+    }
+
+    return previousBounds.getUnion (curveBounds);
+}
+
+//==============================================================================
+float SpectrumDisplay::frequencyToX (float frequency, float sampleRate) const noexcept
+{
+    const float maxFrequency = 0.5f * sampleRate;
+    const float proportion = std::log (juce::jmax (frequency, SpectrumSnapshot::minFrequency) / SpectrumSnapshot::minFrequency)
+                           / std::log (maxFrequency / SpectrumSnapshot::minFrequency);
+    return proportion * (float)getWidth();
+}
+
+float SpectrumDisplay::decibelsToY (float decibels) const noexcept
+{
+    const float clamped = juce::jlimit (minDecibels, maxDecibels, decibels);
+    return juce::jmap (clamped, maxDecibels, minDecibels, 0.0f, (float)getHeight());
+}
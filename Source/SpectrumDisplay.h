@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    SpectrumDisplay.h
+    Created: 9 Apr 2023 4:05:52pm
+    Author:  Onez
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/SpectrumTap.h"
+
+//==============================================================================
+/**
+    Draws the input magnitude, the stochastic envelope and the noise kernel
+    from the processor's SpectrumTap. Only ever reads the tap from the
+    message thread, at most frameRateHz times a second, and only repaints
+    the area the curves moved through.
+*/
+class SpectrumDisplay  : public juce::Component,
+                         private juce::Timer
+{
+public:
+    explicit SpectrumDisplay (SpectrumTap& tapToRead);
+    ~SpectrumDisplay() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void renderBackground();
+    juce::Rectangle<int> renderCurves (const SpectrumSnapshot& snapshot);
+
+    float frequencyToX (float frequency, float sampleRate) const noexcept;
+    float decibelsToY (float decibels) const noexcept;
+
+    static constexpr int frameRateHz = 30;
+    static constexpr float minDecibels = -80.0f;
+    static constexpr float maxDecibels = 60.0f;
+
+    SpectrumTap& tap;
+    juce::Image backgroundImage;
+    juce::Image curveImage;
+    juce::Rectangle<int> curveBounds;
+    float lastSampleRate = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumDisplay)
+};
@@ -9,8 +9,7 @@
 */
 
 #pragma once
-#include "JuceHeader.h"
-int string_to_fftsize(int index){
+inline int string_to_fftsize(int index){
     int fftsize;
     switch (index) {
         case 0:
@@ -39,6 +38,7 @@ int string_to_fftsize(int index){
             break;
         case 8:
             fftsize = 16384;
+            break;
         default:
             fftsize = 2048;
             break;
@@ -0,0 +1,324 @@
+/*
+  ==============================================================================
+
+    stocsynth_bench.cpp
+    Created: 23 Apr 2023 3:02:17pm
+    Author:  Onez
+
+    Offline CPU benchmark of the engine. Every case renders the same
+    noise at 48 kHz (stereo, in 512 sample blocks unless it says otherwise)
+    and reports the share of one core it needs to keep up with real time.
+    The band split cases run at 96 kHz, next to the same preset without it.
+    Then the same length as one file on every core, as it is and
+    time-stretched, and last the oscillator bank of the sinusoidal mode
+    against resynthesising the same partials with an inverse FFT.
+
+    usage: stocsynth_bench [seconds of audio per case]
+    STOCSYNTH_ISA=sse2 / avx2 in the environment benchmarks the lower kernels.
+
+  ==============================================================================
+*/
+
+#include "StocSynthEngine.h"
+#include "DspKernels.h"
+#include "FFT.h"
+#include "OscillatorBank.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+
+    struct BenchCase
+    {
+        const char* name;
+        std::function<void (StocSynthEngine&)> setup;
+        int blockSize = 512;
+        int numChannels = 2;
+        double rate = sampleRate;
+    };
+
+    double run (const BenchCase& benchCase, double seconds)
+    {
+        const int blockSize = benchCase.blockSize;
+        const int numChannels = benchCase.numChannels;
+        StocSynthEngine engine;
+        benchCase.setup (engine);
+        engine.prepare (benchCase.rate, blockSize, numChannels);
+
+        std::vector<float> input ((size_t)blockSize * numChannels * 64);
+        std::mt19937 random (1);
+        std::uniform_real_distribution<float> noise (-0.5f, 0.5f);
+        for (auto& sample : input)
+            sample = noise (random);
+
+        std::vector<float> block ((size_t)blockSize * numChannels);
+        std::vector<float*> channels;
+        for (int channel = 0; channel < numChannels; ++channel)
+            channels.push_back (block.data() + (size_t)channel * blockSize);
+        const int numBlocks = (int)(seconds * benchCase.rate / blockSize);
+
+        double elapsed = 0.0;
+        for (int i = 0; i < numBlocks; ++i) {
+            // fresh input every block, the engine works in place
+            const float* source = input.data() + (size_t)(i % 64) * blockSize * numChannels;
+            std::copy (source, source + block.size(), block.begin());
+
+            const auto start = std::chrono::steady_clock::now();
+            engine.process (channels.data(), numChannels, blockSize);
+            elapsed += std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+        }
+
+        return 100.0 * elapsed / ((double)numBlocks * blockSize / benchCase.rate);
+    }
+
+    // the render preset over one stereo file with renderOffline (), or stretched by `stretch`,
+    // in multiples of real time (of the output)
+    double runOffline (double seconds, double stretch, int& numThreads)
+    {
+        const int64_t numSamples = (int64_t)(seconds * sampleRate);
+        std::vector<std::vector<float>> file (2, std::vector<float> ((size_t)numSamples));
+        std::mt19937 random (1);
+        std::uniform_real_distribution<float> noise (-0.5f, 0.5f);
+        for (auto& channel : file)
+            for (auto& sample : channel)
+                sample = noise (random);
+
+        StocSynthEngine engine;
+        engine.applyPreset (StocSynthEngine::presetRender);
+        engine.prepare (sampleRate, 512, 2);
+        float* channels[] = { file[0].data(), file[1].data() };
+        numThreads = (int)std::max (1u, std::thread::hardware_concurrency());
+
+        const int64_t numOutputSamples = StocSynthEngine::getStretchedLength (numSamples, stretch);
+        std::vector<std::vector<float>> stretched (2, std::vector<float> ((size_t)numOutputSamples));
+        float* outputs[] = { stretched[0].data(), stretched[1].data() };
+
+        const auto start = std::chrono::steady_clock::now();
+        if (stretch == 1.0)
+            engine.renderOffline (channels, 2, numSamples, numThreads);
+        else
+            engine.renderStretched (channels, outputs, 2, numSamples, stretch, numThreads);
+        const double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+        return (double)numOutputSamples / sampleRate / elapsed;
+    }
+
+    // numPartials steady partials for `seconds` of 48 kHz in 256 sample hops, either through
+    // OscillatorBank or the inverse FFT way (main lobes of a Blackman-Harris window added into a
+    // 1024 bin spectrum, inverse transform, overlap-add). Returns the share of one core each needs
+    void runPartials (int numPartials, double seconds, double& bankCpu, double& inverseCpu)
+    {
+        constexpr int hopSize = 256, fftOrder = 10, fftSize = 1 << fftOrder, lobeBins = 4, lobeSteps = 64;
+        const int numHops = (int)(seconds * sampleRate / hopSize);
+        const double audio = (double)numHops * hopSize / sampleRate;
+        std::mt19937 random (1);
+        std::uniform_real_distribution<float> bins (8.0f, fftSize / 2 - 8.0f);
+        std::vector<float> frequencies ((size_t)numPartials);
+        for (auto& frequency : frequencies)
+            frequency = bins (random) * 2.0f * (float)M_PI / fftSize;
+        std::vector<float> output ((size_t)hopSize);
+
+        OscillatorBank bank;
+        bank.prepare (numPartials, hopSize);
+        for (int partial = 0; partial < numPartials; ++partial)
+            bank.start (partial, frequencies[(size_t)partial]);
+        auto start = std::chrono::steady_clock::now();
+        for (int hop = 0; hop < numHops; ++hop) {
+            for (int partial = 0; partial < numPartials; ++partial)
+                bank.setTarget (partial, frequencies[(size_t)partial], 0.01f);
+            std::fill (output.begin(), output.end(), 0.0f);
+            bank.render (output.data(), hopSize);
+        }
+        bankCpu = 100.0 * std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count() / audio;
+
+        // the 4 term Blackman-Harris transform, sampled every 1 / lobeSteps bin out to lobeBins
+        const double terms[] = { 0.35875, -0.48829, 0.14128, -0.01168 };
+        std::vector<float> lobe ((size_t)(lobeBins * lobeSteps + 1));
+        for (size_t step = 0; step < lobe.size(); ++step) {
+            auto sinc = [] (double bin) { return std::fabs (bin) < 1.0e-9 ? 1.0 : std::sin (M_PI * bin) / (M_PI * bin); };
+            const double bin = (double)step / lobeSteps;
+            double value = terms[0] * sinc (bin);
+            for (int term = 1; term < 4; ++term)
+                value += 0.5 * terms[term] * (sinc (bin - term) + sinc (bin + term));
+            lobe[step] = (float)value;
+        }
+
+        FFT fft (fftOrder);
+        std::vector<std::complex<float>> spectrum ((size_t)fftSize / 2 + 1), scratch ((size_t)fftSize / 2);
+        std::vector<float> frame ((size_t)fftSize), overlap ((size_t)fftSize), phases ((size_t)numPartials, 0.0f);
+        start = std::chrono::steady_clock::now();
+        for (int hop = 0; hop < numHops; ++hop) {
+            std::fill (spectrum.begin(), spectrum.end(), std::complex<float> (0.0f, 0.0f));
+            for (int partial = 0; partial < numPartials; ++partial) {
+                const float bin = frequencies[(size_t)partial] * fftSize / (2.0f * (float)M_PI);
+                const std::complex<float> phasor = std::polar (0.01f, phases[(size_t)partial]);
+                phases[(size_t)partial] = std::fmod (phases[(size_t)partial] + frequencies[(size_t)partial] * hopSize, 2.0f * (float)M_PI);
+                for (int index = (int)bin - lobeBins + 1; index <= (int)bin + lobeBins; ++index) {
+                    const int step = (int)std::lround (std::fabs ((float)index - bin) * lobeSteps);
+                    spectrum[(size_t)index] += phasor * lobe[(size_t)std::min (step, lobeBins * lobeSteps)];
+                }
+            }
+            fft.performRealInverse (spectrum.data(), frame.data(), fftSize / 2 + 1, scratch.data());
+
+            // overlap-add, then the oldest hop is done
+            for (int index = 0; index < fftSize; ++index)
+                overlap[(size_t)index] += frame[(size_t)index];
+            std::copy (overlap.begin(), overlap.begin() + hopSize, output.begin());
+            std::copy (overlap.begin() + hopSize, overlap.end(), overlap.begin());
+            std::fill (overlap.end() - hopSize, overlap.end(), 0.0f);
+        }
+        inverseCpu = 100.0 * std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count() / audio;
+    }
+
+    std::vector<BenchCase> makeCases()
+    {
+        std::vector<BenchCase> cases;
+        for (int preset = 0; preset < StocSynthEngine::numPresets; ++preset)
+            cases.push_back ({ StocSynthEngine::getPresetSettings (preset).name,
+                               [preset] (StocSynthEngine& engine) { engine.applyPreset (preset); } });
+
+        // only the band below the default LowCutoff of 2 kHz resynthesised
+        cases.push_back ({ "mix, pruned", [] (StocSynthEngine& engine) {
+            engine.applyPreset (StocSynthEngine::presetMix);
+            engine.setBinPruning (true);
+        } });
+
+        // rendering with big host buffers, where several hops land in every block
+        auto tracking = [] (bool batched) {
+            return [batched] (StocSynthEngine& engine) {
+                engine.applyPreset (StocSynthEngine::presetTracking);
+                engine.setFrameBatching (batched);
+            };
+        };
+        cases.push_back ({ "tracking, 4096 blocks", tracking (true), 4096 });
+        cases.push_back ({ "tracking, 4096, unbatched", tracking (false), 4096 });
+
+        // 8 channel stems, one channel at a time or all of them in vector lanes
+        auto mix = [] (bool lanes) {
+            return [lanes] (StocSynthEngine& engine) {
+                engine.applyPreset (StocSynthEngine::presetMix);
+                engine.setChannelLanes (lanes);
+            };
+        };
+        cases.push_back ({ "mix, 8 channels", mix (false), 512, 8 });
+        cases.push_back ({ "mix, 8 channels, lanes", mix (true), 512, 8 });
+
+        // sinusoids plus residual, noise has a peak every few bins so every partial is busy
+        cases.push_back ({ "mix, 256 partials", [] (StocSynthEngine& engine) {
+            engine.applyPreset (StocSynthEngine::presetMix);
+            engine.setSinusoids (256);
+        } });
+
+        // the noise from a filter bank instead of the inverse FFT, same level and spectrum within about 1 dB
+        auto filterBank = [] (int preset, int numBands) {
+            return [preset, numBands] (StocSynthEngine& engine) {
+                engine.applyPreset (preset);
+                engine.setFilterBank (numBands);
+            };
+        };
+        cases.push_back ({ "mix, filter bank 24", filterBank (StocSynthEngine::presetMix, 24) });
+        cases.push_back ({ "mix, filter bank 40", filterBank (StocSynthEngine::presetMix, 40) });
+        cases.push_back ({ "render, filter bank 24", filterBank (StocSynthEngine::presetRender, 24) });
+        cases.push_back ({ "render, filter bank 40", filterBank (StocSynthEngine::presetRender, 40) });
+
+        // random phasors instead of the analysed phases, no trigonometry per bin
+        auto phasors = [] (int preset) {
+            return [preset] (StocSynthEngine& engine) {
+                engine.applyPreset (preset);
+                engine.setPhasorPhases (true);
+            };
+        };
+        cases.push_back ({ "mix, phasors", phasors (StocSynthEngine::presetMix) });
+        cases.push_back ({ "render, phasors", phasors (StocSynthEngine::presetRender) });
+
+        // LowCutoff at 2 kHz on a 96 kHz session, the whole band or only the band below 2 kHz through the STFT
+        auto bandSplit = [] (int preset, float splitFrequency) {
+            return [preset, splitFrequency] (StocSynthEngine& engine) {
+                engine.applyPreset (preset);
+                engine.setLowCutoff (2000.0f);
+                engine.setBandSplit (splitFrequency);
+            };
+        };
+        cases.push_back ({ "mix, 96 kHz", bandSplit (StocSynthEngine::presetMix, 0.0f), 512, 2, 96000.0 });
+        cases.push_back ({ "mix, 96 kHz, split 2 kHz", bandSplit (StocSynthEngine::presetMix, 2000.0f), 512, 2, 96000.0 });
+        cases.push_back ({ "render, 96 kHz", bandSplit (StocSynthEngine::presetRender, 0.0f), 512, 2, 96000.0 });
+        cases.push_back ({ "render, 96 kHz, split 2 kHz", bandSplit (StocSynthEngine::presetRender, 2000.0f), 512, 2, 96000.0 });
+
+        // hops of 16 samples on the mix preset's FFT, bins above 2 kHz pruned, FFT or sliding DFT per hop
+        auto highOverlap = [] (bool sliding) {
+            return [sliding] (StocSynthEngine& engine) {
+                engine.configure (2048, 128, STFT::windowTypeHann);
+                engine.setLowCutoff (2000.0f);
+                engine.setBinPruning (true);
+                engine.setSlidingDft (sliding);
+            };
+        };
+        cases.push_back ({ "mix, hop 16, pruned", highOverlap (false) });
+        cases.push_back ({ "mix, hop 16, pruned, sliding", highOverlap (true) });
+
+        // a spectral gate and a tilt on the stochastic resynthesis' frames, sharing its FFT pair
+        auto gateAndTilt = [] (int preset) {
+            return [preset] (StocSynthEngine& engine) {
+                engine.applyPreset (preset);
+                const int gate = engine.addSpectralNode (SpectralNode::typeGate);
+                engine.setSpectralNodeParameter (gate, SpectralGate::thresholdDb, -50.0f);
+                const int tilt = engine.addSpectralNode (SpectralNode::typeTilt);
+                engine.setSpectralNodeParameter (tilt, SpectralTilt::slopeDb, -3.0f);
+            };
+        };
+        cases.push_back ({ "mix, gate + tilt", gateAndTilt (StocSynthEngine::presetMix) });
+        cases.push_back ({ "render, gate + tilt", gateAndTilt (StocSynthEngine::presetRender) });
+
+        // the envelope analysed every fourth hop and interpolated in between, with or without onset detection
+        auto envelopeDecimation = [] (int preset, float fluxThreshold) {
+            return [preset, fluxThreshold] (StocSynthEngine& engine) {
+                engine.applyPreset (preset);
+                engine.setEnvelopeDecimation (4, fluxThreshold);
+            };
+        };
+        cases.push_back ({ "mix, envelope / 4", envelopeDecimation (StocSynthEngine::presetMix, 0.0f) });
+        cases.push_back ({ "mix, envelope / 4, flux", envelopeDecimation (StocSynthEngine::presetMix, 0.5f) });
+        cases.push_back ({ "render, envelope / 4", envelopeDecimation (StocSynthEngine::presetRender, 0.0f) });
+        cases.push_back ({ "render, envelope / 4, flux", envelopeDecimation (StocSynthEngine::presetRender, 0.5f) });
+        return cases;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::atof (argv[1]) : 20.0;
+
+    std::printf ("kernels: %s\n", DspKernels::getIsaName (DspKernels::getIsa()));
+    std::printf ("%-28s %8s %10s\n", "case", "latency", "cpu");
+    for (const auto& benchCase : makeCases()) {
+        const double cpu = run (benchCase, seconds);
+
+        StocSynthEngine engine;
+        benchCase.setup (engine);
+        engine.prepare (benchCase.rate, benchCase.blockSize, benchCase.numChannels);
+        std::printf ("%-28s %6.1fms %9.2f%%\n", benchCase.name,
+                     1000.0 * engine.getLatencySamples() / benchCase.rate, cpu);
+    }
+
+    int numThreads = 0;
+    const double speed = runOffline (seconds, 1.0, numThreads);
+    std::printf ("render, offline: %.1fx real time on %d threads\n", speed, numThreads);
+    const double stretchedSpeed = runOffline (seconds, 2.0, numThreads);
+    std::printf ("render, stretched 2x: %.1fx real time on %d threads\n", stretchedSpeed, numThreads);
+
+    for (const int numPartials : { 64, 256, 512 }) {
+        double bankCpu = 0.0, inverseCpu = 0.0;
+        runPartials (numPartials, seconds, bankCpu, inverseCpu);
+        std::printf ("%d partials, one channel: oscillator bank %.2f%%, inverse FFT %.2f%%\n", numPartials, bankCpu, inverseCpu);
+    }
+    return 0;
+}
@@ -0,0 +1,379 @@
+/*
+  ==============================================================================
+
+    stocsynth_soak.cpp
+    Created: 4 Jun 2023 2:26:13pm
+    Author:  Onez
+
+    Soak test: drives the engine the way StocSynthAudioProcessor does, for
+    hours of simulated audio, and keeps the worst of it instead of the
+    average. The host re-enters prepareToPlay () every few seconds to a
+    minute with a new sample rate, block size, channel count and preset,
+    with the processor's calls in the processor's order, now and then on
+    a new instance (a fresh engine) or after releaseResources (). In
+    between it sends random block sizes up to the prepared one (with
+    the odd ones some hosts use), automates every parameter, switches the
+    preset, bin pruning, the governor and the bypass, starts and stops
+    bounces (the offline quality profile), and feeds noise, silence, sines,
+    clicks and denormals. Every real-time callback is timed into a histogram,
+    in microseconds and as a share of its real-time budget, every output
+    sample is checked for NaN / Inf, and the engine's repair counters
+    (SpectralGuard) are summed up. The callbacks run with denormals
+    flushed to zero, as juce::ScopedNoDenormals has them in processBlock ().
+
+    usage: stocsynth_soak [hours of audio, default 1] [seed]
+    Exits with 1 if the output was ever not finite, 2 on bad arguments.
+
+  ==============================================================================
+*/
+
+#include "StocSynthEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#if defined (__x86_64__) || defined (__i386__) || defined (_M_X64)
+ #include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // FTZ and DAZ for the scope, like juce::ScopedNoDenormals (x86 only, other targets run unchanged)
+    class ScopedNoDenormals
+    {
+    public:
+       #if defined (__x86_64__) || defined (__i386__) || defined (_M_X64)
+        ScopedNoDenormals() noexcept : previous (_mm_getcsr()) { _mm_setcsr (previous | flushToZero | denormalsAreZero); }
+        ~ScopedNoDenormals() noexcept { _mm_setcsr (previous); }
+
+    private:
+        static constexpr unsigned flushToZero = 0x8000;
+        static constexpr unsigned denormalsAreZero = 0x0040;
+        const unsigned previous;
+       #endif
+    };
+
+    // log2 buckets, 16 per octave, from 1 / 16 up
+    class Histogram
+    {
+    public:
+        void add (double value)
+        {
+            const double position = value > 0.0 ? bucketsPerOctave * (std::log2 (value) + offset) : 0.0;
+            ++counts[(size_t)std::min ((double)numBuckets - 1, std::max (0.0, position))];
+            maximum = std::max (maximum, value);
+            ++total;
+        }
+
+        // upper edge of the bucket holding that fraction of the values
+        double getPercentile (double fraction) const
+        {
+            const uint64_t target = (uint64_t)std::ceil (fraction * (double)total);
+            uint64_t seen = 0;
+            for (int bucket = 0; bucket < numBuckets; ++bucket)
+                if ((seen += counts[(size_t)bucket]) >= target && seen > 0)
+                    return std::min (maximum, std::exp2 ((bucket + 1.0) / bucketsPerOctave - offset));
+            return maximum;
+        }
+
+        double getMaximum() const noexcept { return maximum; }
+
+    private:
+        static constexpr int bucketsPerOctave = 16;
+        static constexpr int numBuckets = bucketsPerOctave * 48;
+        static constexpr double offset = 4.0;
+        std::vector<uint64_t> counts = std::vector<uint64_t> ((size_t)numBuckets, 0);
+        double maximum = 0.0;
+        uint64_t total = 0;
+    };
+
+    // what StocSynthAudioProcessor hands the engine, the same ranges as its parameter layout
+    struct Parameters
+    {
+        float stochFactor = 0.5f;
+        float noiseLevel = 0.05f;
+        float amp = 0.5f;
+        float lowCutoff = 2000.0f;
+        bool governor = false;
+        bool bypass = false;
+        int preset = StocSynthEngine::presetMix;
+        bool realtimeBinPruning = false;
+        // the host is bouncing, isNonRealtime ()
+        bool nonRealtime = false;
+    };
+
+    struct Soak
+    {
+        explicit Soak (unsigned seed) : random (seed) {}
+
+        std::mt19937 random;
+        // the plugin instance's, replaced now and then, see prepareToPlay ()
+        std::unique_ptr<StocSynthEngine> engine;
+        Parameters parameters;
+        double sampleRate = 48000.0;
+        int maxBlockSize = 512;
+        int numChannels = 2;
+        std::vector<std::vector<float>> buffers;
+        std::vector<float*> channels;
+
+        // the input generator: what it plays and for how long
+        int source = 0;
+        int64_t sourceRemaining = 0;
+        double phase = 0.0, frequency = 440.0;
+        float level = 0.1f;
+
+        Histogram micros, load;
+        uint64_t callbacks = 0, prepares = 0, instances = 0, releases = 0, nonFiniteSamples = 0, nonFiniteCallbacks = 0;
+        uint64_t repairedFrames = 0, repairedValues = 0, seenFrames = 0, seenValues = 0;
+        double simulated = 0.0;
+
+        float uniform (float low, float high) { return std::uniform_real_distribution<float> (low, high) (random); }
+        int pick (int count) { return std::uniform_int_distribution<int> (0, count - 1) (random); }
+        bool chance (double probability) { return std::bernoulli_distribution (probability) (random); }
+
+        // what the engine's repair counters gained since the last look
+        void countRepairs()
+        {
+            repairedFrames += engine->getRepairedFrameCount() - seenFrames;
+            repairedValues += engine->getRepairedValueCount() - seenValues;
+            seenFrames = engine->getRepairedFrameCount();
+            seenValues = engine->getRepairedValueCount();
+        }
+
+        // the counters start over with prepare () and lose the degraded tiers' counts when those are rebuilt
+        template <typename Change>
+        void reconfigure (Change&& change)
+        {
+            countRepairs();
+            change();
+            seenFrames = engine->getRepairedFrameCount();
+            seenValues = engine->getRepairedValueCount();
+        }
+
+        // the quality profiles and the governor, like the processor does: the offline profile at its defaults
+        void applyQualityProfile()
+        {
+            const auto& preset = StocSynthEngine::getPresetSettings (parameters.preset);
+            engine->setQualityProfiles ({ preset.fftSize, preset.overlap, preset.windowType, parameters.realtimeBinPruning },
+                                       { 8192, 8, STFT::windowTypeHann, false });
+            engine->setNonRealtime (parameters.nonRealtime);
+            engine->setGovernor (parameters.governor && ! parameters.nonRealtime);
+        }
+
+        // StocSynthAudioProcessor::prepareToPlay (): release, profiles, governor and then the layout.
+        // Now and then on a new instance, freshly inserted with the default parameters or restoring a
+        // session with whatever the last one had, or after the host let go with releaseResources ()
+        void prepareToPlay()
+        {
+            static const double rates[] { 44100.0, 48000.0, 88200.0, 96000.0, 22050.0 };
+            static const int blockSizes[] { 32, 64, 128, 256, 441, 480, 512, 1000, 1024, 2048, 4096 };
+            sampleRate = rates[pick (5)];
+            maxBlockSize = blockSizes[pick (11)];
+            numChannels = 1 + pick (2);
+
+            if (engine == nullptr || chance (0.2)) {
+                if (engine != nullptr)
+                    countRepairs();
+                engine = std::make_unique<StocSynthEngine>();
+                seenFrames = seenValues = 0;
+                if (chance (0.5))
+                    parameters = Parameters();
+                ++instances;
+            } else {
+                parameters.preset = pick (StocSynthEngine::numPresets);
+                if (chance (0.2)) {
+                    engine->release();
+                    ++releases;
+                }
+            }
+
+            reconfigure ([this] {
+                engine->release();
+                applyQualityProfile();
+                engine->prepare (sampleRate, maxBlockSize, numChannels);
+            });
+
+            buffers.assign ((size_t)numChannels, std::vector<float> ((size_t)maxBlockSize, 0.0f));
+            channels.clear();
+            for (auto& buffer : buffers)
+                channels.push_back (buffer.data());
+            ++prepares;
+        }
+
+        // mostly the prepared size, sometimes whatever the host feels like (never more, as JUCE promises)
+        int nextBlockSize()
+        {
+            switch (pick (8)) {
+                case 0:  return 1 + pick (maxBlockSize);
+                case 1:  return std::max (1, maxBlockSize - 1);
+                case 2:  return std::min (maxBlockSize, 1 + pick (3) * 2);
+                case 3:  return std::max (1, maxBlockSize / 3);
+                default: return maxBlockSize;
+            }
+        }
+
+        void automate (int blockSize)
+        {
+            // jumps now and then, small steps otherwise
+            auto move = [this] (float& value, float low, float high, float step) {
+                value = chance (0.01) ? uniform (low, high) : std::min (high, std::max (low, value + uniform (-step, step)));
+            };
+            move (parameters.stochFactor, 0.1f, 1.0f, 0.02f);
+            move (parameters.noiseLevel, 0.0f, 0.1f, 0.002f);
+            move (parameters.amp, 0.01f, 2.0f, 0.05f);
+            move (parameters.lowCutoff, 10.0f, 20000.0f, 200.0f);
+
+            // a few times a minute: the preset, bin pruning and the governor (message thread, processing
+            // suspended) and the bypass, a bounce starting or ending now and then
+            const double perBlock = blockSize / sampleRate / 20.0;
+            if (chance (perBlock)) {
+                parameters.preset = pick (StocSynthEngine::numPresets);
+                reconfigure ([this] { applyQualityProfile(); });
+            }
+            if (chance (perBlock)) {
+                parameters.realtimeBinPruning = ! parameters.realtimeBinPruning;
+                reconfigure ([this] { applyQualityProfile(); });
+            }
+            if (chance (perBlock)) {
+                parameters.governor = ! parameters.governor;
+                reconfigure ([this] { applyQualityProfile(); });
+            }
+            if (chance (perBlock / 4.0)) {
+                parameters.nonRealtime = ! parameters.nonRealtime;
+                reconfigure ([this] { applyQualityProfile(); });
+            }
+            if (chance (perBlock))
+                parameters.bypass = ! parameters.bypass;
+
+            engine->setStochFactor (parameters.stochFactor);
+            engine->setNoiseLevel (parameters.noiseLevel);
+            engine->setLowCutoff (parameters.lowCutoff);
+            engine->setAmp (parameters.amp);
+            engine->setBypassed (parameters.bypass);
+        }
+
+        void fillInput (int blockSize)
+        {
+            for (int sample = 0; sample < blockSize; ++sample) {
+                if (sourceRemaining-- <= 0) {
+                    // noise, silence, a sine, clicks, denormals or full scale noise, for up to two seconds
+                    source = pick (6);
+                    sourceRemaining = (int64_t)(uniform (0.01f, 2.0f) * sampleRate);
+                    level = std::pow (10.0f, uniform (-4.0f, 0.0f));
+                    frequency = std::pow (10.0, uniform (1.5f, 4.3f));
+                }
+
+                float value = 0.0f;
+                switch (source) {
+                    case 0: value = level * uniform (-1.0f, 1.0f); break;
+                    case 2:
+                        value = level * (float)std::sin (phase);
+                        phase = std::fmod (phase + 2.0 * M_PI * frequency / sampleRate, 2.0 * M_PI);
+                        break;
+                    case 3: value = chance (0.001) ? level : 0.0f; break;
+                    case 4: value = 1.0e-39f * uniform (-1.0f, 1.0f); break;
+                    case 5: value = uniform (-1.0f, 1.0f); break;
+                    default: break;
+                }
+                for (auto& buffer : buffers)
+                    buffer[(size_t)sample] = value;
+            }
+        }
+
+        void callback (int blockSize)
+        {
+            automate (blockSize);
+            fillInput (blockSize);
+
+            const ScopedNoDenormals noDenormals;
+            const auto start = std::chrono::steady_clock::now();
+            engine->process (channels.data(), numChannels, blockSize);
+            const double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+            // a bounce has no budget
+            const double budget = blockSize / sampleRate;
+            if (! parameters.nonRealtime) {
+                micros.add (1.0e6 * elapsed);
+                load.add (elapsed / budget);
+            }
+
+            uint64_t bad = 0;
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int sample = 0; sample < blockSize; ++sample)
+                    bad += std::isfinite (buffers[(size_t)channel][(size_t)sample]) ? 0 : 1;
+            if (bad > 0 && nonFiniteCallbacks++ == 0)
+                std::printf ("first NaN / Inf at %.1f s: %d Hz, block %d of %d, %d channels, fft %d / %d, source %d, "
+                             "stoch %.3f noise %.4f amp %.3f cutoff %.0f, governor %d bypass %d\n",
+                             simulated, (int)sampleRate, blockSize, maxBlockSize, numChannels,
+                             engine->getFftSize(), engine->getOverlap(), source, parameters.stochFactor,
+                             parameters.noiseLevel, parameters.amp, parameters.lowCutoff,
+                             (int)parameters.governor, (int)parameters.bypass);
+            nonFiniteSamples += bad;
+            simulated += budget;
+            ++callbacks;
+        }
+
+        void run (double seconds)
+        {
+            double nextPrepare = 0.0;
+            while (simulated < seconds) {
+                if (simulated >= nextPrepare) {
+                    prepareToPlay();
+                    nextPrepare = simulated + uniform (5.0f, 60.0f);
+                }
+                callback (nextBlockSize());
+            }
+        }
+    };
+}
+
+int main (int argc, char* argv[])
+{
+    if (argc > 1 && (std::strcmp (argv[1], "--help") == 0 || std::strcmp (argv[1], "-h") == 0)) {
+        std::printf ("usage: stocsynth_soak [hours of audio > 0, default 1] [seed, default 1]\n");
+        return 0;
+    }
+
+    // a typo must not pass as a run of 0 hours
+    double hours = 1.0;
+    unsigned long seed = 1;
+    char* end = nullptr;
+    bool valid = argc <= 3;
+    if (valid && argc > 1) {
+        hours = std::strtod (argv[1], &end);
+        valid = end != argv[1] && *end == '\0' && hours > 0.0 && std::isfinite (hours);
+    }
+    if (valid && argc > 2) {
+        seed = std::strtoul (argv[2], &end, 10);
+        valid = end != argv[2] && *end == '\0';
+    }
+    if (! valid) {
+        std::fprintf (stderr, "usage: stocsynth_soak [hours of audio > 0, default 1] [seed, default 1]\n");
+        return 2;
+    }
+
+    Soak soak ((unsigned)seed);
+    const auto start = std::chrono::steady_clock::now();
+    soak.run (hours * 3600.0);
+    const double wall = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+    std::printf ("%.2f h of audio in %.0f s, %llu callbacks, %llu prepareToPlay on %llu instances, %llu releaseResources\n",
+                 soak.simulated / 3600.0, wall, (unsigned long long)soak.callbacks, (unsigned long long)soak.prepares,
+                 (unsigned long long)soak.instances, (unsigned long long)soak.releases);
+    std::printf ("%-10s %10s %10s %10s %10s\n", "", "p50", "p99", "p99.9", "max");
+    std::printf ("%-10s %10.1f %10.1f %10.1f %10.1f\n", "us", soak.micros.getPercentile (0.5), soak.micros.getPercentile (0.99),
+                 soak.micros.getPercentile (0.999), soak.micros.getMaximum());
+    std::printf ("%-10s %9.2f%% %9.2f%% %9.2f%% %9.2f%%\n", "of budget", 100.0 * soak.load.getPercentile (0.5),
+                 100.0 * soak.load.getPercentile (0.99), 100.0 * soak.load.getPercentile (0.999), 100.0 * soak.load.getMaximum());
+    std::printf ("non-finite output: %llu samples in %llu callbacks\n",
+                 (unsigned long long)soak.nonFiniteSamples, (unsigned long long)soak.nonFiniteCallbacks);
+    soak.countRepairs();
+    std::printf ("repaired by the engine: %llu values in %llu frames\n",
+                 (unsigned long long)soak.repairedValues, (unsigned long long)soak.repairedFrames);
+    return soak.nonFiniteSamples > 0 ? 1 : 0;
+}